@@ -0,0 +1,298 @@
+// pilla-bench: compiler throughput on generated programs.
+// times lexer, parser, sema, codegen (IR + optimization) and backend separately
+// and writes the results as json so two builds can be diffed. codegen and backend
+// are measured both per function (default) and in -fwhole-module mode, codegen
+// also with -fparallel-codegen and backend with -j on every core
+
+#include "ProgramGenerator.h"
+#include "lexer/Lexer.h"
+#include "parser/Parser.h"
+#include "sema/Sema.h"
+#include "codegen/Codegen.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+    // counts every node of the AST, used for the parser throughput
+    class NodeCounter : public ASTVisitor {
+        public:
+        long count = 0;
+
+        long visit(ProgramAST& node) override {
+            count++;
+            for (auto& func : node.functions) func->accept(*this);
+            return 0;
+        }
+        long visit(FunctionAST& node) override {
+            count++;
+            statements(node.body);
+            return 0;
+        }
+        long visit(VariableDeclAST& node) override {
+            count++;
+            if (node.initializer) node.initializer->accept(*this);
+            return 0;
+        }
+        long visit(ReturnStmtAST& node) override {
+            count++;
+            if (node.expression) node.expression->accept(*this);
+            return 0;
+        }
+        long visit(PrintStmtAST& node) override {
+            count++;
+            node.expression->accept(*this);
+            return 0;
+        }
+        long visit(IfStmtAST& node) override {
+            count++;
+            node.condition->accept(*this);
+            statements(node.thenBranch);
+            statements(node.elseBranch);
+            return 0;
+        }
+        long visit(WhileStmtAST& node) override {
+            count++;
+            node.condition->accept(*this);
+            statements(node.body);
+            return 0;
+        }
+        long visit(ForStmtAST& node) override {
+            count++;
+            if (node.initializer) node.initializer->accept(*this);
+            if (node.condition) node.condition->accept(*this);
+            if (node.increment) node.increment->accept(*this);
+            statements(node.body);
+            return 0;
+        }
+        long visit(CallExprAST& node) override {
+            count++;
+            for (auto& arg : node.args) arg->accept(*this);
+            return 0;
+        }
+        long visit(BinaryExprAST& node) override {
+            count++;
+            node.left->accept(*this);
+            node.right->accept(*this);
+            return 0;
+        }
+        long visit(NumberExprAST&) override { count++; return 0; }
+        long visit(VariableExprAST&) override { count++; return 0; }
+        long visit(FloatExprAST&) override { count++; return 0; }
+        long visit(StringExprAST&) override { count++; return 0; }
+        long visit(CharExprAST&) override { count++; return 0; }
+
+        private:
+        void statements(std::vector<std::unique_ptr<StmtAST>>& body) {
+            for (auto& stmt : body) stmt->accept(*this);
+        }
+    };
+
+    using Clock = std::chrono::steady_clock;
+
+    double secondsSince(Clock::time_point start) {
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    struct PhaseResult {
+        std::vector<double> samples;
+
+        double min() const { return *std::min_element(samples.begin(), samples.end()); }
+        double mean() const {
+            double sum = 0;
+            for (double s : samples) sum += s;
+            return sum / samples.size();
+        }
+    };
+
+    void usage(const char* argv0) {
+        std::cerr << "Usage: " << argv0 << " [options]\n";
+        std::cerr << "Options:\n";
+        std::cerr << "  --functions=<n>         Functions in the generated program (default: 100)\n";
+        std::cerr << "  --depth=<n>             Nesting depth of if/while/for (default: 3)\n";
+        std::cerr << "  --expr-length=<n>       Binary operators per expression (default: 8)\n";
+        std::cerr << "  --comment-density=<f>   Comment lines per statement (default: 0.25)\n";
+        std::cerr << "  --seed=<n>              Generator seed (default: 42)\n";
+        std::cerr << "  --iterations=<n>        Runs per phase (default: 5)\n";
+        std::cerr << "  --json=<file>           Results file, '-' for stdout (default: pilla-bench.json)\n";
+        std::cerr << "  --emit-source=<file>    Also write the generated program\n";
+    }
+
+    bool startsWith(const std::string& arg, const std::string& prefix, std::string& value) {
+        if (arg.rfind(prefix, 0) != 0) return false;
+        value = arg.substr(prefix.size());
+        return true;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    GeneratorConfig config;
+    unsigned iterations = 5;
+    std::string jsonFile = "pilla-bench.json";
+    std::string sourceFile;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        std::string value;
+        // getAsInteger/getAsDouble return true when value is not a number
+        bool invalid = false;
+        if (startsWith(arg, "--functions=", value)) {
+            invalid = llvm::StringRef(value).getAsInteger(10, config.functions);
+        } else if (startsWith(arg, "--depth=", value)) {
+            invalid = llvm::StringRef(value).getAsInteger(10, config.depth);
+        } else if (startsWith(arg, "--expr-length=", value)) {
+            invalid = llvm::StringRef(value).getAsInteger(10, config.exprLength);
+        } else if (startsWith(arg, "--comment-density=", value)) {
+            invalid = llvm::StringRef(value).getAsDouble(config.commentDensity);
+        } else if (startsWith(arg, "--seed=", value)) {
+            invalid = llvm::StringRef(value).getAsInteger(10, config.seed);
+        } else if (startsWith(arg, "--iterations=", value)) {
+            invalid = llvm::StringRef(value).getAsInteger(10, iterations);
+            iterations = std::max(1u, iterations);
+        } else if (startsWith(arg, "--json=", value)) {
+            jsonFile = value;
+        } else if (startsWith(arg, "--emit-source=", value)) {
+            sourceFile = value;
+        } else {
+            invalid = true;
+        }
+        if (invalid) {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    std::string code = generateProgram(config);
+    if (!sourceFile.empty()) {
+        std::ofstream(sourceFile) << code;
+    }
+
+    // backend output goes to a scratch file
+    llvm::SmallString<128> objectPath;
+    if (llvm::sys::fs::createTemporaryFile("pilla-bench", "o", objectPath)) {
+        std::cerr << "Error: could not create temporary file\n";
+        return 1;
+    }
+
+    Codegen::initializeTargets();
+
+    PhaseResult lexer, parser, sema, codegen, backend;
+    PhaseResult codegenWholeModule, backendWholeModule;
+    PhaseResult codegenParallel, backendParallel;
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    size_t tokenCount = 0;
+    long nodeCount = 0;
+
+    for (unsigned iter = 0; iter < iterations; iter++) {
+        auto start = Clock::now();
+        Lexer lex(code);
+        std::vector<Token> tokens = lex.scanTokens();
+        lexer.samples.push_back(secondsSince(start));
+        tokenCount = tokens.size();
+
+        start = Clock::now();
+        Parser parse(tokens);
+        std::unique_ptr<ProgramAST> ast = parse.parse();
+        parser.samples.push_back(secondsSince(start));
+        if (!ast) {
+            std::cerr << "Error: generated program does not parse\n";
+            return 1;
+        }
+
+        NodeCounter counter;
+        ast->accept(counter);
+        nodeCount = counter.count;
+
+        start = Clock::now();
+        Semantics semantics;
+        bool ok = semantics.analyze(*ast);
+        sema.samples.push_back(secondsSince(start));
+        if (!ok) {
+            std::cerr << "Error: generated program fails semantic analysis\n";
+            return 1;
+        }
+
+        for (bool wholeModule : {false, true}) {
+            CodegenOptions options;
+            options.wholeModule = wholeModule;
+
+            start = Clock::now();
+            Codegen gen(options);
+            ast->accept(gen);
+            (wholeModule ? codegenWholeModule : codegen).samples.push_back(secondsSince(start));
+
+            start = Clock::now();
+            gen.emitObjectCode(std::string(objectPath));
+            (wholeModule ? backendWholeModule : backend).samples.push_back(secondsSince(start));
+        }
+
+        CodegenOptions parallelOptions;
+        parallelOptions.codegenThreads = threads;
+        parallelOptions.backendThreads = threads;
+        start = Clock::now();
+        Codegen parallelGen(parallelOptions);
+        ast->accept(parallelGen);
+        codegenParallel.samples.push_back(secondsSince(start));
+
+        start = Clock::now();
+        parallelGen.emitObjectCode(std::string(objectPath));
+        backendParallel.samples.push_back(secondsSince(start));
+    }
+    llvm::sys::fs::remove(objectPath);
+
+    std::error_code EC;
+    llvm::raw_fd_ostream os(jsonFile, EC, llvm::sys::fs::OF_Text);
+    if (EC) {
+        std::cerr << "Error: could not open '" << jsonFile << "': " << EC.message() << "\n";
+        return 1;
+    }
+
+    auto phase = [](llvm::json::OStream& json, const char* name, const PhaseResult& result,
+                    const char* unit, double items) {
+        json.attributeObject(name, [&] {
+            json.attribute("min_seconds", result.min());
+            json.attribute("mean_seconds", result.mean());
+            if (unit) json.attribute(unit, items / result.min());
+        });
+    };
+
+    llvm::json::OStream json(os, 2);
+    json.object([&] {
+        json.attributeObject("config", [&] {
+            json.attribute("functions", (int64_t)config.functions);
+            json.attribute("depth", (int64_t)config.depth);
+            json.attribute("expr_length", (int64_t)config.exprLength);
+            json.attribute("comment_density", config.commentDensity);
+            json.attribute("seed", (int64_t)config.seed);
+            json.attribute("iterations", (int64_t)iterations);
+            json.attribute("codegen_threads", (int64_t)threads);
+        });
+        json.attribute("source_bytes", (int64_t)code.size());
+        json.attribute("tokens", (int64_t)tokenCount);
+        json.attribute("ast_nodes", (int64_t)nodeCount);
+        json.attributeObject("phases", [&] {
+            phase(json, "lexer", lexer, "tokens_per_sec", tokenCount);
+            phase(json, "parser", parser, "nodes_per_sec", nodeCount);
+            phase(json, "sema", sema, "nodes_per_sec", nodeCount);
+            phase(json, "codegen", codegen, nullptr, 0);
+            phase(json, "backend", backend, nullptr, 0);
+            phase(json, "codegen_whole_module", codegenWholeModule, nullptr, 0);
+            phase(json, "backend_whole_module", backendWholeModule, nullptr, 0);
+            phase(json, "codegen_parallel", codegenParallel, nullptr, 0);
+            phase(json, "backend_parallel", backendParallel, nullptr, 0);
+        });
+    });
+    os << "\n";
+
+    return 0;
+}
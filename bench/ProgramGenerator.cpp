@@ -0,0 +1,237 @@
+#include "ProgramGenerator.h"
+#include <algorithm>
+#include <random>
+#include <sstream>
+#include <vector>
+
+namespace {
+
+    const char* commentWords[] = {
+        "accumulate", "the", "partial", "result", "before", "next", "iteration",
+        "keep", "values", "small", "enough", "to", "avoid", "overflow", "here"
+    };
+
+    class Generator {
+        public:
+        Generator(const GeneratorConfig& config) : config(config), rng(config.seed) {}
+
+        std::string run() {
+            out << "// synthetic pilla program: " << config.functions << " functions, depth "
+                << config.depth << ", expression length " << config.exprLength << "\n\n";
+            for (unsigned i = 0; i < config.functions; i++) {
+                function(i);
+            }
+            mainFunction();
+            return out.str();
+        }
+
+        private:
+        const GeneratorConfig& config;
+        std::mt19937 rng;
+        std::ostringstream out;
+        int indent = 0;
+        unsigned currentFunction = 0;
+        unsigned nextVar = 0;
+        // variables visible at the current point, one vector per block
+        std::vector<std::vector<std::string>> scopes;
+
+        unsigned pick(unsigned n) {
+            return std::uniform_int_distribution<unsigned>(0, n - 1)(rng);
+        }
+
+        bool chance(double p) {
+            return std::uniform_real_distribution<double>(0.0, 1.0)(rng) < p;
+        }
+
+        void line(const std::string& text) {
+            out << std::string(indent * 4, ' ') << text << "\n";
+        }
+
+        void comments() {
+            double density = config.commentDensity;
+            while (density >= 1.0) {
+                comment();
+                density -= 1.0;
+            }
+            if (chance(density)) comment();
+        }
+
+        void comment() {
+            std::string text;
+            unsigned words = 4 + pick(8);
+            for (unsigned i = 0; i < words; i++) {
+                if (i) text += " ";
+                text += commentWords[pick(sizeof(commentWords) / sizeof(commentWords[0]))];
+            }
+            if (chance(0.2)) {
+                line("/* " + text + " */");
+            } else {
+                line("// " + text);
+            }
+        }
+
+        std::string freshVar(const std::string& prefix) {
+            return prefix + std::to_string(nextVar++);
+        }
+
+        std::string anyVar() {
+            unsigned total = 0;
+            for (const auto& scope : scopes) total += scope.size();
+            unsigned index = pick(total);
+            for (const auto& scope : scopes) {
+                if (index < scope.size()) return scope[index];
+                index -= scope.size();
+            }
+            return "a";
+        }
+
+        // loop counters are left alone so the generated loops still terminate
+        std::string assignableVar() {
+            std::vector<std::string> candidates;
+            for (const auto& scope : scopes) {
+                for (const auto& name : scope) {
+                    if (name[0] != 'i' && name[0] != 'w') candidates.push_back(name);
+                }
+            }
+            return candidates[pick(candidates.size())];
+        }
+
+        std::string term() {
+            unsigned kind = pick(10);
+            if (kind < 5) return anyVar();
+            if (kind < 9 || currentFunction == 0) return std::to_string(1 + pick(100));
+            // call an earlier function, callees have to be emitted first
+            unsigned callee = currentFunction - 1 - pick(std::min(currentFunction, 4u));
+            return "f" + std::to_string(callee) + "(" + anyVar() + ", " + std::to_string(pick(10)) + ")";
+        }
+
+        std::string expression() {
+            static const char* ops[] = {" + ", " - ", " * ", " + ", " - "};
+            std::string expr = term();
+            for (unsigned i = 0; i < config.exprLength; i++) {
+                // only divide by non zero constants
+                if (chance(0.1)) {
+                    expr += (chance(0.5) ? " / " : " % ") + std::to_string(2 + pick(9));
+                } else {
+                    expr += ops[pick(5)] + term();
+                }
+            }
+            return expr;
+        }
+
+        void declare(const std::string& name) {
+            scopes.back().push_back(name);
+        }
+
+        void block(unsigned depth) {
+            comments();
+            std::string var = freshVar("v");
+            line("int " + var + " = " + expression() + ";");
+            declare(var);
+
+            comments();
+            std::string target = assignableVar();
+            line(target + " = " + expression() + ";");
+
+            if (depth < config.depth) {
+                compound(depth + 1);
+            }
+
+            if (chance(0.1)) {
+                comments();
+                line("printf(" + anyVar() + ");");
+            }
+        }
+
+        void enter() {
+            indent++;
+            scopes.push_back({});
+        }
+
+        void leave() {
+            scopes.pop_back();
+            indent--;
+        }
+
+        void compound(unsigned depth) {
+            comments();
+            switch (depth % 3) {
+                case 0: {
+                    std::string counter = freshVar("i");
+                    line("for (int " + counter + " = 0; " + counter + " < " + std::to_string(2 + pick(8)) +
+                         "; " + counter + " = " + counter + " + 1) {");
+                    enter();
+                    declare(counter);
+                    block(depth);
+                    leave();
+                    line("}");
+                    break;
+                }
+                case 1: {
+                    line("if (" + expression() + " > " + std::to_string(pick(50)) + ") {");
+                    enter();
+                    block(depth);
+                    leave();
+                    line("} else {");
+                    enter();
+                    block(depth);
+                    leave();
+                    line("}");
+                    break;
+                }
+                default: {
+                    std::string counter = freshVar("w");
+                    line("int " + counter + " = 0;");
+                    declare(counter);
+                    line("while (" + counter + " < " + std::to_string(2 + pick(4)) + ") {");
+                    enter();
+                    block(depth);
+                    line(counter + " = " + counter + " + 1;");
+                    leave();
+                    line("}");
+                    break;
+                }
+            }
+        }
+
+        void function(unsigned index) {
+            currentFunction = index;
+            nextVar = 0;
+            comments();
+            line("int f" + std::to_string(index) + "(int a, int b) {");
+            enter();
+            declare("a");
+            declare("b");
+            line("int acc = a + b;");
+            declare("acc");
+            for (int i = 0; i < 3; i++) {
+                block(0);
+            }
+            line("return acc + " + expression() + ";");
+            leave();
+            line("}");
+            out << "\n";
+        }
+
+        void mainFunction() {
+            currentFunction = 0;
+            line("int main() {");
+            enter();
+            line("int total = 0;");
+            unsigned calls = std::min(config.functions, 8u);
+            for (unsigned i = 0; i < calls; i++) {
+                unsigned callee = config.functions - 1 - i;
+                line("total = total + f" + std::to_string(callee) + "(total, " + std::to_string(i) + ");");
+            }
+            line("printf(total);");
+            line("return 0;");
+            leave();
+            line("}");
+        }
+    };
+}
+
+std::string generateProgram(const GeneratorConfig& config) {
+    Generator generator(config);
+    return generator.run();
+}
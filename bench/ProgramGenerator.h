@@ -0,0 +1,19 @@
+#ifndef PILLA_BENCH_PROGRAMGENERATOR_H
+#define PILLA_BENCH_PROGRAMGENERATOR_H
+
+#include <string>
+
+// knobs for the synthetic pilla programs used by the benchmarks
+struct GeneratorConfig {
+    unsigned functions = 100;      // number of functions besides main
+    unsigned depth = 3;            // max nesting of if/while/for blocks
+    unsigned exprLength = 8;       // binary operators per expression
+    double commentDensity = 0.25;  // comment lines per statement
+    unsigned seed = 42;
+};
+
+// generates a valid program (passes sema and codegen) for the given config.
+// the same config always gives the same source
+std::string generateProgram(const GeneratorConfig& config);
+
+#endif //PILLA_BENCH_PROGRAMGENERATOR_H
@@ -0,0 +1,293 @@
+// pilla-runbench: speed of the code pilla generates, compared with C.
+// every <kernel>.pilla in the corpus has a hand written <kernel>.c twin. both
+// are built (pilla-compiler + system linker, system C compiler at -O2), run a
+// few times and compared on wall time and retired instructions. results are json
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Program.h"
+#include "llvm/Support/raw_ostream.h"
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace {
+
+    struct Options {
+        std::string compiler;
+        std::string cc = "cc";
+        std::string corpus;
+        std::string workDir;
+        std::string jsonFile = "runtime-bench.json";
+        std::vector<std::string> pillaFlags;
+        unsigned runs = 3;
+    };
+
+    struct RunResult {
+        bool ok = false;
+        std::vector<double> wallSeconds;
+        std::optional<uint64_t> instructions;
+        std::string output;
+    };
+
+    // runs a tool (compiler, linker) and waits for it, tool output is discarded
+    bool runTool(const std::string& program, std::vector<std::string> args) {
+        auto path = llvm::sys::findProgramByName(program);
+        if (!path) {
+            std::cerr << "Error: could not find '" << program << "'\n";
+            return false;
+        }
+        args.insert(args.begin(), *path);
+        std::vector<llvm::StringRef> argv(args.begin(), args.end());
+        std::optional<llvm::StringRef> devNull("/dev/null");
+        std::string message;
+        int rc = llvm::sys::ExecuteAndWait(*path, argv, std::nullopt,
+                                           {std::nullopt, devNull, devNull}, 0, 0, &message);
+        if (rc != 0) {
+            std::cerr << "Error: '" << program << "' failed" << (message.empty() ? "" : ": " + message) << "\n";
+            return false;
+        }
+        return true;
+    }
+
+    int openInstructionCounter(pid_t pid) {
+        perf_event_attr attr{};
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+        attr.disabled = 1;
+        attr.enable_on_exec = 1;
+        attr.inherit = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        return syscall(SYS_perf_event_open, &attr, pid, -1, -1, 0);
+    }
+
+    // one timed run of an executable, stdout goes to outputFile.
+    // the child waits on a pipe until the counter is attached, the counter starts at exec
+    bool timedRun(const std::string& exe, const std::string& outputFile,
+                  double& seconds, std::optional<uint64_t>& instructions) {
+        int gate[2];
+        if (pipe(gate) != 0) return false;
+
+        pid_t pid = fork();
+        if (pid < 0) return false;
+        if (pid == 0) {
+            close(gate[1]);
+            char c;
+            if (read(gate[0], &c, 1) < 0) _exit(127);
+            close(gate[0]);
+            int fd = open(outputFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (fd >= 0) {
+                dup2(fd, STDOUT_FILENO);
+                close(fd);
+            }
+            execl(exe.c_str(), exe.c_str(), (char*)nullptr);
+            _exit(127);
+        }
+
+        close(gate[0]);
+        int counter = openInstructionCounter(pid);
+        auto start = std::chrono::steady_clock::now();
+        if (write(gate[1], "x", 1) != 1) {
+            close(gate[1]);
+            return false;
+        }
+        close(gate[1]);
+
+        int status = 0;
+        waitpid(pid, &status, 0);
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        instructions.reset();
+        if (counter >= 0) {
+            uint64_t count = 0;
+            if (read(counter, &count, sizeof(count)) == sizeof(count)) instructions = count;
+            close(counter);
+        }
+        return WIFEXITED(status);
+    }
+
+    RunResult measure(const std::string& exe, const std::string& outputFile, unsigned runs) {
+        RunResult result;
+        for (unsigned i = 0; i < runs; i++) {
+            double seconds = 0;
+            std::optional<uint64_t> instructions;
+            if (!timedRun(exe, outputFile, seconds, instructions)) return result;
+            result.wallSeconds.push_back(seconds);
+            if (instructions && (!result.instructions || *instructions < *result.instructions)) {
+                result.instructions = instructions;
+            }
+        }
+        if (auto buffer = llvm::MemoryBuffer::getFile(outputFile)) {
+            result.output = (*buffer)->getBuffer().str();
+        }
+        result.ok = true;
+        return result;
+    }
+
+    double minOf(const std::vector<double>& samples) {
+        return *std::min_element(samples.begin(), samples.end());
+    }
+
+    double meanOf(const std::vector<double>& samples) {
+        double sum = 0;
+        for (double s : samples) sum += s;
+        return sum / samples.size();
+    }
+
+    void writeRun(llvm::json::OStream& json, const char* name, const RunResult& run) {
+        json.attributeObject(name, [&] {
+            json.attribute("ok", run.ok);
+            if (!run.ok) return;
+            json.attribute("wall_seconds_min", minOf(run.wallSeconds));
+            json.attribute("wall_seconds_mean", meanOf(run.wallSeconds));
+            if (run.instructions) {
+                json.attribute("instructions", (int64_t)*run.instructions);
+            } else {
+                json.attribute("instructions", nullptr);
+            }
+        });
+    }
+
+    void usage(const char* argv0) {
+        std::cerr << "Usage: " << argv0 << " --compiler=<pilla-compiler> --corpus=<dir> [options]\n";
+        std::cerr << "Options:\n";
+        std::cerr << "  --cc=<compiler>       C compiler and linker (default: cc)\n";
+        std::cerr << "  --work-dir=<dir>      Where binaries are built (default: temporary directory)\n";
+        std::cerr << "  --runs=<n>            Runs per binary (default: 3)\n";
+        std::cerr << "  --pilla-flag=<flag>   Extra flag for pilla-compiler, can be repeated\n";
+        std::cerr << "  --json=<file>         Results file, '-' for stdout (default: runtime-bench.json)\n";
+    }
+
+    bool startsWith(const std::string& arg, const std::string& prefix, std::string& value) {
+        if (arg.rfind(prefix, 0) != 0) return false;
+        value = arg.substr(prefix.size());
+        return true;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        std::string value;
+        if (startsWith(arg, "--compiler=", value)) {
+            options.compiler = value;
+        } else if (startsWith(arg, "--cc=", value)) {
+            options.cc = value;
+        } else if (startsWith(arg, "--corpus=", value)) {
+            options.corpus = value;
+        } else if (startsWith(arg, "--work-dir=", value)) {
+            options.workDir = value;
+        } else if (startsWith(arg, "--runs=", value)) {
+            if (llvm::StringRef(value).getAsInteger(10, options.runs)) {
+                usage(argv[0]);
+                return 1;
+            }
+            options.runs = std::max(1u, options.runs);
+        } else if (startsWith(arg, "--pilla-flag=", value)) {
+            options.pillaFlags.push_back(value);
+        } else if (startsWith(arg, "--json=", value)) {
+            options.jsonFile = value;
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (options.compiler.empty() || options.corpus.empty()) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (options.workDir.empty()) {
+        llvm::SmallString<128> dir;
+        if (llvm::sys::fs::createUniqueDirectory("pilla-runbench", dir)) {
+            std::cerr << "Error: could not create work directory\n";
+            return 1;
+        }
+        options.workDir = std::string(dir);
+    } else {
+        llvm::sys::fs::create_directories(options.workDir);
+    }
+
+    // kernels are the .pilla files that have a .c twin
+    std::vector<std::string> kernels;
+    std::error_code EC;
+    for (llvm::sys::fs::directory_iterator it(options.corpus, EC), end; it != end && !EC; it.increment(EC)) {
+        llvm::StringRef path = it->path();
+        if (llvm::sys::path::extension(path) != ".pilla") continue;
+        llvm::SmallString<128> twin(path);
+        llvm::sys::path::replace_extension(twin, "c");
+        if (llvm::sys::fs::exists(twin)) {
+            kernels.push_back(llvm::sys::path::stem(path).str());
+        }
+    }
+    std::sort(kernels.begin(), kernels.end());
+    if (kernels.empty()) {
+        std::cerr << "Error: no kernels found in '" << options.corpus << "'\n";
+        return 1;
+    }
+
+    llvm::raw_fd_ostream os(options.jsonFile, EC, llvm::sys::fs::OF_Text);
+    if (EC) {
+        std::cerr << "Error: could not open '" << options.jsonFile << "': " << EC.message() << "\n";
+        return 1;
+    }
+
+    llvm::json::OStream json(os, 2);
+    json.object([&] {
+        json.attribute("runs", (int64_t)options.runs);
+        json.attributeArray("pilla_flags", [&] {
+            for (const auto& flag : options.pillaFlags) json.value(flag);
+        });
+        json.attributeArray("kernels", [&] {
+            for (const auto& kernel : kernels) {
+                std::cerr << "kernel " << kernel << "\n";
+                std::string base = options.workDir + "/" + kernel;
+                std::string source = options.corpus + "/" + kernel;
+
+                // pilla: compile to an object and link it with the C runtime
+                std::vector<std::string> compileArgs = {source + ".pilla", "-o", base + ".pilla.o"};
+                compileArgs.insert(compileArgs.end(), options.pillaFlags.begin(), options.pillaFlags.end());
+                bool pillaBuilt = runTool(options.compiler, compileArgs) &&
+                                  runTool(options.cc, {base + ".pilla.o", "-o", base + ".pilla"});
+                bool cBuilt = runTool(options.cc, {"-O2", source + ".c", "-o", base + ".c"});
+
+                RunResult pilla, native;
+                if (pillaBuilt) pilla = measure(base + ".pilla", base + ".pilla.out", options.runs);
+                if (cBuilt) native = measure(base + ".c", base + ".c.out", options.runs);
+
+                json.object([&] {
+                    json.attribute("name", kernel);
+                    writeRun(json, "pilla", pilla);
+                    writeRun(json, "c", native);
+                    if (pilla.ok && native.ok) {
+                        json.attribute("outputs_match", pilla.output == native.output);
+                        json.attribute("wall_time_ratio", minOf(pilla.wallSeconds) / minOf(native.wallSeconds));
+                        if (pilla.instructions && native.instructions) {
+                            json.attribute("instruction_ratio",
+                                           (double)*pilla.instructions / (double)*native.instructions);
+                        }
+                    }
+                });
+            }
+        });
+    });
+    os << "\n";
+
+    return 0;
+}
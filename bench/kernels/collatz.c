@@ -0,0 +1,28 @@
+#include <stdio.h>
+
+long collatzLength(long n) {
+    long steps = 1;
+    while (n != 1) {
+        if (n % 2 == 0) {
+            n = n / 2;
+        } else {
+            n = 3 * n + 1;
+        }
+        steps = steps + 1;
+    }
+    return steps;
+}
+
+int main(void) {
+    long best = 0;
+    long bestStart = 0;
+    for (long i = 1; i < 1000000; i = i + 1) {
+        long len = collatzLength(i);
+        if (len > best) {
+            best = len;
+            bestStart = i;
+        }
+    }
+    printf("%ld %ld\n", bestStart, best);
+    return 0;
+}
@@ -0,0 +1,13 @@
+#include <stdio.h>
+
+int main(void) {
+    double sum = 0.0;
+    double sign = 1.0;
+    for (long i = 0; i < 200000000; i = i + 1) {
+        double d = 2.0 * i + 1.0;
+        sum = sum + sign / d;
+        sign = 0.0 - sign;
+    }
+    printf("%f\n", sum * 4.0);
+    return 0;
+}
@@ -0,0 +1,30 @@
+#include <stdio.h>
+
+long mandel(double cx, double cy) {
+    double x = 0.0;
+    double y = 0.0;
+    long it = 0;
+    long inside = 1;
+    while (it < 200) {
+        double xx = x * x - y * y + cx;
+        y = 2.0 * x * y + cy;
+        x = xx;
+        if (x * x + y * y > 4.0) {
+            inside = 0;
+            it = 200;
+        }
+        it = it + 1;
+    }
+    return inside;
+}
+
+int main(void) {
+    long count = 0;
+    for (long py = 0; py < 1200; py = py + 1) {
+        for (long px = 0; px < 1600; px = px + 1) {
+            count = count + mandel(px * 0.002 - 2.2, py * 0.002 - 1.2);
+        }
+    }
+    printf("%ld\n", count);
+    return 0;
+}
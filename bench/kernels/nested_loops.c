@@ -0,0 +1,14 @@
+#include <stdio.h>
+
+int main(void) {
+    long sum = 0;
+    for (long i = 0; i < 600; i = i + 1) {
+        for (long j = 0; j < 600; j = j + 1) {
+            for (long k = 0; k < 600; k = k + 1) {
+                sum = sum + i * j % 7 + k % 5;
+            }
+        }
+    }
+    printf("%ld\n", sum);
+    return 0;
+}
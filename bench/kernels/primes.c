@@ -0,0 +1,26 @@
+#include <stdio.h>
+
+long isPrime(long n) {
+    if (n < 2) {
+        return 0;
+    }
+    long d = 2;
+    long prime = 1;
+    while (d * d <= n) {
+        if (n % d == 0) {
+            prime = 0;
+            d = n;
+        }
+        d = d + 1;
+    }
+    return prime;
+}
+
+int main(void) {
+    long count = 0;
+    for (long i = 0; i < 1000000; i = i + 1) {
+        count = count + isPrime(i);
+    }
+    printf("%ld\n", count);
+    return 0;
+}
@@ -3,6 +3,7 @@
 
 #include "passes/pass1.h"
 #include "passes/pass2.h"
+#include "jit/ObjectCache.h"
 #include "parser/AST.h"
 #include "llvm/IR/Value.h"
 #include "llvm/IR/IRBuilder.h"
@@ -10,6 +11,7 @@
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/PassManager.h"
 #include "llvm/Passes/PassBuilder.h"
+#include "llvm/Passes/StandardInstrumentations.h"
 #include "llvm/Analysis/LoopAnalysisManager.h"
 #include "llvm/Analysis/CGSCCPassManager.h"
 #include "llvm/Target/TargetMachine.h"
@@ -19,21 +21,68 @@
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/Host.h"
 #include "llvm/IR/LegacyPassManager.h"
+#include "llvm/ExecutionEngine/Orc/ThreadSafeModule.h"
+#include <functional>
 #include <string>
 #include <vector>
 #include <map>
 #include <memory>
 
+// knobs for the code generator, filled from the command line
+struct CodegenOptions {
+    // write per function instruction statistics after each pipeline stage (--ir-stats=<file>)
+    std::string irStatsFile;
+    // textual pass pipeline replacing the built in one (-passes=<pipeline>)
+    std::string passPipeline;
+    // pass plugins to load before the pipeline is parsed (-load-pass-plugin=<.so>)
+    std::vector<std::string> passPlugins;
+    // emit the whole module first and leave all optimization to the module
+    // pipeline instead of simplifying each function while emitting (-fwhole-module)
+    bool wholeModule = false;
+    // JIT object cache (--jit-cache): the module gets its cache key as identifier
+    // and the module pipeline is skipped when the cache already has the object
+    JITObjectCache* objectCache = nullptr;
+    // false: emit the module without running any pass (tier 1 of --tiered)
+    bool optimize = true;
+    // > 1: functions are emitted and run through the function pipeline on this
+    // many threads, each with its own context, then linked (-fparallel-codegen)
+    unsigned codegenThreads = 1;
+    // > 1: the optimized module is split into this many partitions, each
+    // compiled to machine code on its own thread, then combined with ld -r (-j<n>)
+    unsigned backendThreads = 1;
+    // -flto=thin: write bitcode with a module summary instead of an object,
+    // the backend runs in the link step (ThinLTOLink)
+    bool thinLTO = false;
+};
+
 class Codegen : public ASTVisitor {
 public:
-    Codegen();
+    Codegen(const CodegenOptions& options = CodegenOptions());
     void generate(ProgramAST& program);
     llvm::Module* getModule() { return module.get(); }
+    // hands the module and its context over (to the JIT), codegen is unusable afterwards
+    llvm::orc::ThreadSafeModule takeModule();
+    // false if a plugin could not be loaded or the -passes pipeline did not parse
+    bool pipelineValid() const { return pipelineOk; }
+    // false if the -fparallel-codegen partitions could not be linked back into
+    // one module. the emit methods then refuse to write an incomplete output
+    bool generated() const { return generateOk; }
     
     // Machine code generation methods
-    void initializeTargets();
-    void emitObjectCode(const std::string& filename);
-    void emitAssembly(const std::string& filename);
+    static void initializeTargets();
+    // false if the file could not be written (the reason is printed)
+    bool emitObjectCode(const std::string& filename);
+    // the object into memory, always single threaded (used by --incremental and --watch)
+    bool emitObjectCode(llvm::SmallVectorImpl<char>& buffer);
+    bool emitAssembly(const std::string& filename);
+    // -flto=thin: the optimized module and its summary (calls, references and
+    // size of every function) as bitcode
+    bool emitThinLTOBitcode(const std::string& filename);
+    // host target machine, created once per thread
+    static llvm::TargetMachine* hostTargetMachine();
+    // every prototype (external linkage), but only the given bodies, each run
+    // through the function pipeline. used by -fparallel-codegen and --incremental
+    void emitPartition(ProgramAST& program, const std::vector<FunctionAST*>& partition);
 
     long visit(ProgramAST& node) override;
     long visit(FunctionAST& node) override;
@@ -53,10 +102,26 @@ public:
 
 private:
     llvm::Type* getLLVMType(const std::string& typeName);
+    // creates the prototype of a function, or returns the existing one
+    llvm::Function* declareFunction(FunctionAST& node);
+    // -fparallel-codegen: emits the partitions on worker threads and links them into module
+    void generateParallel(ProgramAST& program);
+    // -j<n>: isel and register allocation of the partitions run in parallel
+    bool emitObjectCodeParallel(const std::string& filename,
+                                const std::function<std::unique_ptr<llvm::TargetMachine>()>& createTargetMachine);
+    // runs instruction selection and the rest of the backend over the module
+    bool emitObjectTo(llvm::TargetMachine& targetMachine, llvm::raw_pwrite_stream& dest);
+    // tail/musttail for calls sema found in tail position
+    void markTailCall(llvm::CallInst* call, CallExprAST& node);
+    CodegenOptions options;
     std::unique_ptr<llvm::LLVMContext> context;
     std::unique_ptr<llvm::Module> module;
     std::unique_ptr<llvm::IRBuilder<>> builder;
 
+    // pass instrumentation (per pass timers and trace events)
+    llvm::PassInstrumentationCallbacks pic;
+    std::unique_ptr<llvm::StandardInstrumentations> si;
+
     // New Pass Manager members
     llvm::LoopAnalysisManager lam;
     llvm::FunctionAnalysisManager fam;
@@ -66,11 +131,25 @@ private:
 
     llvm::FunctionPassManager fpm;
     llvm::ModulePassManager mpm;
+    bool pipelineOk = true;
+    bool generateOk = true;
+
+    // lets the pilla passes appear by name in textual pipelines
+    void registerPillaPasses();
+    // everything besides the IR that changes the optimized code, part of the cache key
+    std::string pipelineKey() const;
+    // the default per function optimizations
+    static void addFunctionPasses(llvm::FunctionPassManager& passes);
+
+    // only set with --ir-stats
+    std::unique_ptr<llvm::IRStatsRecorder> irStats;
+    void recordIRStats(llvm::StringRef stage, llvm::Function& function);
 
     std::map<std::string, llvm::Value*> namedValues;
     llvm::Value* lastValue = nullptr;
 
     llvm::Value* logError(const char* str);
+    void logWarning(const std::string& str);
 };
 
 #endif //PILLA_CODEGEN_H
\ No newline at end of file
@@ -0,0 +1,42 @@
+#ifndef PILLA_BATCHCOMPILER_H
+#define PILLA_BATCHCOMPILER_H
+
+#include "codegen/Codegen.h"
+#include "driver/CompileCache.h"
+#include <mutex>
+#include <string>
+#include <vector>
+
+// compiles several source files in one process (pilla-compiler a.pilla b.pilla ...
+// or @files.rsp). the files are independent, they run on a thread pool, each
+// with its own lexer/parser/sema/codegen, and produce one object per input.
+// targets are initialized once for all of them
+class BatchCompiler {
+    public:
+    // cache may be null
+    BatchCompiler(const CodegenOptions& options, bool emitAssembly, unsigned jobs, CompileCache* cache = nullptr);
+
+    // returns the process exit code: 0 when every file compiled
+    int run(const std::vector<std::string>& inputs);
+
+    // dir/name.pilla -> name.o (name.s, name.bc) in the working directory
+    std::string outputFor(const std::string& input) const;
+
+    // false, with a diagnostic, when two inputs would write the same output
+    // (a/x.pilla b/x.pilla, or a file listed twice)
+    bool checkOutputNames(const std::vector<std::string>& inputs) const;
+
+    // one file, on the calling thread. diagnostics go to std::cerr
+    bool compile(const std::string& input, const std::string& output);
+
+    private:
+    CodegenOptions options;
+    bool emitAssembly;
+    unsigned jobs;
+    CompileCache* cache;
+
+    // output of finished files is printed one file at a time
+    std::mutex printMutex;
+};
+
+#endif //PILLA_BATCHCOMPILER_H
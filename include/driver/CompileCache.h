@@ -0,0 +1,65 @@
+#ifndef PILLA_COMPILECACHE_H
+#define PILLA_COMPILECACHE_H
+
+#include "codegen/Codegen.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/raw_ostream.h"
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+// content addressed cache of compiler outputs (--cache), like ccache.
+// the key hashes the source bytes, the build of the compiler, every flag that
+// changes the output and the target triple and cpu. on a hit the stored .o/.s
+// is copied to the output and nothing is lexed, parsed or compiled.
+// entries are plain files named by their key, a hit bumps the modification
+// time, so when the directory grows past its size limit the least recently
+// used entries are removed first
+class CompileCache {
+    public:
+    // empty dir: the user cache directory (~/.cache/pilla)
+    CompileCache(const std::string& dir, uint64_t maxBytes);
+
+    // targets must be initialized, the key includes the host target machine.
+    // imports: the signatures of the imported modules (importedSignatures)
+    std::string computeKey(llvm::StringRef source, const CodegenOptions& options, bool emitAssembly,
+                           llvm::StringRef imports = "") const;
+
+    // copies the cached output for key to output, false on a miss
+    bool fetch(llvm::StringRef key, const std::string& output);
+    // remembers a freshly written output, may evict old entries
+    void store(llvm::StringRef key, const std::string& output);
+
+    // identifies the compiler binary, a rebuilt compiler invalidates everything
+    static std::string compilerBuildId();
+
+    // the ThinLTO link keeps its backend objects in a directory below this one.
+    // LLVM prunes that directory, but it counts against the same size limit
+    std::string getThinLTODir() const { return dir + "/thinlto"; }
+    // the part of the size limit the entries of this cache leave to the ThinLTO directory
+    uint64_t thinLTOBudget();
+
+    // --cache-stats
+    // also enforces the size limit, the size shown is after eviction
+    void printStats(llvm::raw_ostream& os);
+
+    private:
+    std::string dir;
+    uint64_t maxBytes;
+    std::string buildId;
+
+    // several files are compiled at once in batch mode and in the server
+    std::atomic<unsigned> hits{0};
+    std::atomic<unsigned> misses{0};
+    std::atomic<unsigned> stores{0};
+    std::atomic<unsigned> evictions{0};
+    std::mutex evictMutex;
+
+    std::string pathFor(llvm::StringRef key) const;
+    // total size of the entries and the ThinLTO directory, drops the oldest
+    // entries above maxBytes
+    uint64_t evict();
+};
+
+#endif //PILLA_COMPILECACHE_H
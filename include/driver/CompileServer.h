@@ -0,0 +1,45 @@
+#ifndef PILLA_COMPILESERVER_H
+#define PILLA_COMPILESERVER_H
+
+#include "driver/DriverOptions.h"
+#include "query/QueryEngine.h"
+#include <mutex>
+#include <string>
+#include <vector>
+
+// --serve <socket>: long lived compiler process for build systems. targets are
+// initialized once, the thread pool stays up and every pool thread keeps its
+// target machine, so a request only pays for the compile itself.
+//
+// one request per connection over a unix domain socket, text based:
+//   client: "pilla 1\n", the working directory, then one argument per line,
+//           then it shuts down its sending side
+//   server: "<exit code> <stdout bytes>\n", the stdout text, the stderr text
+// requests can only write object and assembly files (no --run, --interpret,
+// -emit-llvm); -ftime-report, -ftime-trace and --mem-report are server wide.
+// --check requests (editors) share one QueryEngine, a file that was checked
+// before only re-runs the queries its edit affected
+class CompileServer {
+    public:
+    CompileServer(const std::string& socketPath, unsigned jobs);
+
+    // accepts connections until SIGINT/SIGTERM, returns the exit code
+    int run();
+
+    private:
+    std::string socketPath;
+    unsigned jobs;
+    QueryEngine queries;
+    std::mutex queriesMutex;
+
+    void handle(int connection);
+    // compiles one request on the calling thread, returns its exit code
+    int compile(const std::string& workingDir, const std::vector<std::string>& args);
+    int check(const DriverOptions& options);
+};
+
+// --connect <socket>: sends the arguments to a server and prints what it sends
+// back. false when no server answered, the caller compiles in process then
+bool forwardToServer(const std::string& socketPath, const std::vector<std::string>& args, int& exitCode);
+
+#endif //PILLA_COMPILESERVER_H
@@ -0,0 +1,63 @@
+#ifndef PILLA_DRIVEROPTIONS_H
+#define PILLA_DRIVEROPTIONS_H
+
+#include "codegen/Codegen.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// everything the command line can ask for. parsed by the compiler itself and
+// by the compile server for the requests it gets
+struct DriverOptions {
+    std::vector<std::string> inputFiles;
+    std::string outputFile;
+    bool emitAssembly = false;
+    bool emitLLVMOnly = false;
+    bool timeReport = false;
+    bool memReport = false;
+    bool runJIT = false;
+    bool lazyJIT = false;
+    bool jitCache = false;
+    std::string jitCacheDir;
+    bool tiered = false;
+    uint64_t tierThreshold = 1000;
+    bool interpretMode = false;
+    bool dumpBytecode = false;
+    CodegenOptions codegen;
+    std::string timeTraceFile;
+    unsigned timeTraceGranularity = 500;
+    // files compiled at the same time (batch mode, compile server), 0: all cores
+    unsigned jobs = 0;
+    // --cache[=<dir>]: reuse outputs of identical compiles
+    bool compileCache = false;
+    std::string compileCacheDir;
+    uint64_t compileCacheSize = 1024ull * 1024 * 1024;
+    bool cacheStats = false;
+    // --incremental[=<dir>]: per function objects, only changed functions are rebuilt
+    bool incremental = false;
+    std::string incrementalDir;
+    // --serve <socket>: run as compile server
+    std::string serveSocket;
+    // --connect <socket>: hand the compile to a server
+    std::string connectSocket;
+    // --check: front end only, diagnostics through the query engine
+    bool checkOnly = false;
+    bool queryStats = false;
+    // --watch: rebuild on every save of the input, keeping results in memory
+    bool watch = false;
+};
+
+// args without the program name, @files already expanded. unknown options are
+// ignored, a malformed number is reported on std::cerr and returns false
+bool parseDriverOptions(const std::vector<std::string>& args, DriverOptions& options);
+
+// resolves every path valued option (inputs, -o, cache, incremental and
+// trace directories, --ir-stats, pass plugins given as a path) against dir.
+// the compile server uses the client's working directory
+void makePathsAbsolute(DriverOptions& options, const std::string& dir);
+
+// what a single file compile writes without -o: output.o, output.s, or
+// output.bc for -flto=thin (the object again when thinLink links bitcode)
+std::string defaultOutputFile(const DriverOptions& options, bool thinLink = false);
+
+#endif //PILLA_DRIVEROPTIONS_H
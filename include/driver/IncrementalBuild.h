@@ -0,0 +1,65 @@
+#ifndef PILLA_INCREMENTALBUILD_H
+#define PILLA_INCREMENTALBUILD_H
+
+#include "codegen/Codegen.h"
+#include "parser/AST.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+// --incremental: every function is compiled on its own and its optimized
+// bitcode and object are kept, keyed by a hash of its AST (ASTFingerprint), the
+// signatures of the functions it calls, the pipeline flags, the compiler build
+// and the target. the next build only regenerates functions whose key changed
+// and relinks the objects (ld -r), so a one line edit recompiles one function.
+// the price: no inlining or other interprocedural optimization between
+// functions, and functions that are not exported stay hidden globals instead
+// of becoming internal.
+// --watch keeps the entries in memory instead, only those of the last update
+class IncrementalBuild {
+    public:
+    // empty dir: the user cache directory (~/.cache/pilla-incremental)
+    IncrementalBuild(const std::string& dir, const CodegenOptions& options);
+    // entries in memory, for a process that builds the same program again
+    explicit IncrementalBuild(const CodegenOptions& options);
+
+    // compiles the functions without an up to date entry, false on errors
+    bool update(ProgramAST& program);
+
+    // after update: ld -r of the function objects into output
+    bool writeObject(const std::string& output);
+    // after update: the function bitcode linked into one module (-emit-llvm)
+    bool printModule(llvm::raw_ostream& os);
+
+    unsigned getReused() const { return reused; }
+    unsigned getRebuilt() const { return rebuilt; }
+
+    private:
+    std::string dir;
+    CodegenOptions options;
+    bool inMemory = false;
+    // optimized bitcode and object of a function
+    struct Entry {
+        llvm::SmallVector<char, 0> bitcode;
+        llvm::SmallVector<char, 0> object;
+    };
+    std::map<std::string, Entry> entries;
+    // entry of every function of the program, in source order
+    std::vector<std::string> keys;
+    unsigned reused = 0;
+    unsigned rebuilt = 0;
+
+    std::string functionKey(ProgramAST& program, FunctionAST& function) const;
+    bool hasEntry(const std::string& key) const;
+    bool compileFunction(ProgramAST& program, FunctionAST& function, const std::string& key);
+    bool storeEntry(const std::string& key, Entry& entry);
+    // the bitcode of an entry, from memory or from disk
+    std::unique_ptr<llvm::MemoryBuffer> bitcodeOf(const std::string& key) const;
+    std::string pathFor(const std::string& key, const char* extension) const;
+};
+
+#endif //PILLA_INCREMENTALBUILD_H
@@ -0,0 +1,37 @@
+#ifndef PILLA_THINLTOLINK_H
+#define PILLA_THINLTOLINK_H
+
+#include "codegen/Codegen.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// the link step of -flto=thin (pilla-compiler util.bc main.bc -o program.o).
+// every module was compiled on its own to bitcode with a summary of its
+// functions. the thin link only reads the summaries to decide which small
+// functions of other modules each module imports, then the backend of every
+// module (import, inlining, the O2 pipeline, machine code) runs in parallel.
+// the objects are combined with ld -r, so the final link stays `cc program.o`.
+// with a cache directory a module whose code and imports are unchanged is not
+// compiled again, the link of an edited program only redoes what changed
+class ThinLTOLink {
+    public:
+    // jobs: backends at the same time, 0: all cores. empty cacheDir: no cache
+    ThinLTOLink(const CodegenOptions& options, unsigned jobs, const std::string& cacheDir = "",
+                uint64_t cacheBytes = 0);
+
+    // errors are printed, false when an input could not be read, a symbol is
+    // defined twice or a backend failed
+    bool link(const std::vector<std::string>& inputs, const std::string& output);
+
+    // what -flto=thin writes, checked by its magic number
+    static bool isBitcodeFile(const std::string& path);
+
+    private:
+    CodegenOptions options;
+    unsigned jobs;
+    std::string cacheDir;
+    uint64_t cacheBytes;
+};
+
+#endif //PILLA_THINLTOLINK_H
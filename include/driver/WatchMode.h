@@ -0,0 +1,37 @@
+#ifndef PILLA_WATCHMODE_H
+#define PILLA_WATCHMODE_H
+
+#include "driver/DriverOptions.h"
+#include "driver/IncrementalBuild.h"
+#include "query/QueryEngine.h"
+#include <set>
+#include <string>
+
+// --watch: stays running and rebuilds the output every time the input is
+// saved. the front end results (QueryEngine) and the optimized bitcode and
+// object of every function (an in memory IncrementalBuild) are kept between
+// builds, so a save re-parses and re-analyzes the edited functions, compiles
+// only those whose code can differ and relinks the objects (ld -r).
+// the directories of the input and of the modules it imports are watched
+// with inotify, editors that save by writing a new file and renaming it over
+// the old one are seen too
+class WatchMode {
+    public:
+    WatchMode(const DriverOptions& options);
+
+    // builds once, then after every change until SIGINT/SIGTERM
+    int run();
+
+    private:
+    DriverOptions options;
+    std::string input;
+    QueryEngine queries;
+    IncrementalBuild build;
+    // every file the program is read from: the input and its imports
+    std::set<std::string> watchedFiles;
+
+    // one build, diagnostics and the result are printed
+    bool rebuild();
+};
+
+#endif //PILLA_WATCHMODE_H
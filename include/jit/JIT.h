@@ -0,0 +1,33 @@
+#ifndef PILLA_JIT_H
+#define PILLA_JIT_H
+
+#include "jit/ObjectCache.h"
+#include "llvm/ExecutionEngine/Orc/LLJIT.h"
+#include "llvm/ExecutionEngine/Orc/ThreadSafeModule.h"
+#include "llvm/Support/Error.h"
+#include <memory>
+
+// runs a generated module in process instead of writing an object file (--run).
+// symbols the module does not define (printf, ...) come from the compiler process.
+// lazy (--lazy) splits the module per function behind compile on demand stubs,
+// a function is only compiled when it is first called.
+// with a cache, compiled objects are looked up in it and stored to it (eager only)
+class JIT {
+    public:
+    static llvm::Expected<std::unique_ptr<JIT>> create(bool lazy = false, JITObjectCache* cache = nullptr);
+
+    llvm::Error addModule(llvm::orc::ThreadSafeModule module);
+
+    // compiles and calls main, returns its result (0 for void main)
+    llvm::Expected<int> runMain();
+
+    private:
+    JIT(std::unique_ptr<llvm::orc::LLJIT> jit, bool lazy) : jit(std::move(jit)), lazy(lazy) {}
+
+    // an LLLazyJIT when lazy
+    std::unique_ptr<llvm::orc::LLJIT> jit;
+    bool lazy;
+    bool mainReturnsVoid = false;
+};
+
+#endif //PILLA_JIT_H
@@ -0,0 +1,47 @@
+#ifndef PILLA_OBJECTCACHE_H
+#define PILLA_OBJECTCACHE_H
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ExecutionEngine/ObjectCache.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include <memory>
+#include <mutex>
+#include <string>
+
+// on disk cache of the machine code the JIT produces (--jit-cache).
+// codegen hashes the module before the module pipeline together with the host
+// cpu, the pipeline configuration and the compiler build and stores the key as
+// module identifier. on a hit the module pipeline is skipped and the JIT maps
+// the cached object instead of running instruction selection
+class JITObjectCache : public llvm::ObjectCache {
+    public:
+    // empty dir: the user cache directory (~/.cache/pilla-jit)
+    JITObjectCache(const std::string& dir = "");
+
+    // cache key of a module compiled with the given pipeline configuration
+    std::string computeKey(const llvm::Module& module, llvm::StringRef pipeline) const;
+    // reads the object stored under key, false if there is none. codegen
+    // skips the module pipeline only after this succeeded, and the JIT gets
+    // exactly this object, even if the file is evicted or replaced meanwhile
+    bool load(llvm::StringRef key);
+
+    void notifyObjectCompiled(const llvm::Module* module, llvm::MemoryBufferRef object) override;
+    std::unique_ptr<llvm::MemoryBuffer> getObject(const llvm::Module* module) override;
+
+    unsigned getHits() const { return hits; }
+    unsigned getMisses() const { return misses; }
+
+    private:
+    std::string dir;
+    std::string buildId;
+    unsigned hits = 0;
+    unsigned misses = 0;
+    // objects read by load, handed out once by getObject
+    llvm::StringMap<std::unique_ptr<llvm::MemoryBuffer>> loaded;
+    std::mutex loadedMutex;
+
+    std::string pathFor(llvm::StringRef key) const;
+};
+
+#endif //PILLA_OBJECTCACHE_H
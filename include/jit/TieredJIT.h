@@ -0,0 +1,74 @@
+#ifndef PILLA_TIEREDJIT_H
+#define PILLA_TIEREDJIT_H
+
+#include "llvm/ExecutionEngine/Orc/LLJIT.h"
+#include "llvm/ExecutionEngine/Orc/ThreadSafeModule.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/Error.h"
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// tiered execution (--tiered).
+// tier 1: the unoptimized module, compiled fast (no optimization, no isel
+// effort) and instrumented with TierInstrumentPass: call/back edge counters and
+// an indirection slot per function.
+// tier 2: once a function's counter reaches the threshold, a background thread
+// compiles it (with everything it calls) from a clean copy of the module at O3,
+// with the call counts as entry counts and a profile summary built from them,
+// and stores the new address in the slot.
+// calls already running keep executing tier 1 code (no on stack replacement)
+class TieredJIT {
+    public:
+    static llvm::Expected<std::unique_ptr<TieredJIT>> create(uint64_t threshold);
+    ~TieredJIT();
+
+    // module must not be optimized yet
+    llvm::Error addModule(llvm::orc::ThreadSafeModule module);
+
+    // runs main, returns its result (0 for void main). waits for the background
+    // compile in flight, pending ones are dropped
+    llvm::Expected<int> runMain();
+
+    // called from tier 1 code
+    void requestTierUp(unsigned id);
+
+    private:
+    struct TierFunction {
+        std::string name;
+        // calls and back edges, decides when to tier up
+        uint64_t* counter = nullptr;
+        // calls only, the entry count
+        uint64_t* calls = nullptr;
+        void** slot = nullptr;
+        bool optimized = false;
+    };
+
+    TieredJIT(std::unique_ptr<llvm::orc::LLJIT> jit, uint64_t threshold);
+
+    std::unique_ptr<llvm::orc::LLJIT> jit;
+    uint64_t threshold;
+    bool mainReturnsVoid = false;
+
+    // clean (uninstrumented) copy of the module, tier 2 starts from this
+    llvm::SmallVector<char, 0> bitcode;
+    std::vector<TierFunction> functions;
+
+    // background compiler
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable wakeUp;
+    std::deque<unsigned> queue;
+    bool stopping = false;
+
+    void compileLoop();
+    llvm::Error compileTier2(unsigned id);
+    void stopWorker();
+};
+
+#endif //PILLA_TIEREDJIT_H
@@ -83,6 +83,10 @@ class CallExprAST : public ExprAST {
     public:
     std::string callee;
     std::vector<std::unique_ptr<ExprAST>> args;
+    // set by sema: the call is the value of a return statement
+    bool tailCall = false;
+    // set by sema: the callee can call back into the caller (same call graph SCC)
+    bool recursive = false;
     CallExprAST(const std::string& callee, std::vector<std::unique_ptr<ExprAST>> args)
         : callee(callee), args(std::move(args)) {}
     long accept(ASTVisitor& visitor) override;
@@ -181,11 +185,14 @@ class FunctionAST {
     std::string name;
     std::vector<std::pair<std::string, std::string>> parameters; 
     std::vector<std::unique_ptr<StmtAST>> body;
+    // 'export' functions (and main) stay visible outside the module
+    bool exported;
 
     FunctionAST(const std::string& returnType, const std::string& name, 
                 std::vector<std::pair<std::string, std::string>> params,
-                std::vector<std::unique_ptr<StmtAST>> body)
-        : returnType(returnType), name(name), parameters(std::move(params)), body(std::move(body)) {}
+                std::vector<std::unique_ptr<StmtAST>> body, bool exported = false)
+        : returnType(returnType), name(name), parameters(std::move(params)), body(std::move(body)),
+          exported(exported) {}
         
     long accept(ASTVisitor& visitor);
 };
@@ -194,6 +201,11 @@ class FunctionAST {
 class ProgramAST {
     public:
     std::vector<std::unique_ptr<FunctionAST>> functions;
+    // import "other.pilla"; paths as written, relative to the importing file
+    std::vector<std::string> imports;
+    // prototypes (no body) of the functions exported by the imported modules,
+    // filled from their interface files (parser/ModuleInterface.h)
+    std::vector<std::unique_ptr<FunctionAST>> imported;
 
     ProgramAST(std::vector<std::unique_ptr<FunctionAST>> funcs)
         : functions(std::move(funcs)) {}
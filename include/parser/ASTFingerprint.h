@@ -0,0 +1,47 @@
+#ifndef PILLA_ASTFINGERPRINT_H
+#define PILLA_ASTFINGERPRINT_H
+
+#include "parser/AST.h"
+#include <set>
+#include <string>
+
+// canonical text of one function's AST, used as the input of a hash.
+// two functions with the same fingerprint compile to the same code, as long
+// as the signatures of their callees are the same too (comments, whitespace
+// and source positions never show up). includes the call annotations of sema
+class ASTFingerprint : public ASTVisitor {
+    public:
+    std::string of(FunctionAST& function);
+
+    // functions called by the last function given to of()
+    const std::set<std::string>& callees() const { return calledFunctions; }
+
+    long visit(ProgramAST& node) override;
+    long visit(FunctionAST& node) override;
+    long visit(VariableDeclAST& node) override;
+    long visit(ReturnStmtAST& node) override;
+    long visit(PrintStmtAST& node) override;
+    long visit(IfStmtAST& node) override;
+    long visit(WhileStmtAST& node) override;
+    long visit(ForStmtAST& node) override;
+    long visit(NumberExprAST& node) override;
+    long visit(VariableExprAST& node) override;
+    long visit(CallExprAST& node) override;
+    long visit(BinaryExprAST& node) override;
+    long visit(FloatExprAST& node) override;
+    long visit(StringExprAST& node) override;
+    long visit(CharExprAST& node) override;
+
+    private:
+    std::string text;
+    std::set<std::string> calledFunctions;
+
+    // every node starts with a tag, strings are length prefixed, so different
+    // trees never produce the same text
+    void tag(char t);
+    void add(const std::string& value);
+    void add(long value);
+    void statements(std::vector<std::unique_ptr<StmtAST>>& body);
+};
+
+#endif //PILLA_ASTFINGERPRINT_H
@@ -0,0 +1,74 @@
+#ifndef PILLA_MODULEINTERFACE_H
+#define PILLA_MODULEINTERFACE_H
+
+#include "parser/AST.h"
+#include "llvm/ADT/StringRef.h"
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+// what importers of a module see: the signatures of its exported functions.
+// stored next to the source as a compact binary interface file
+// (other.pilla -> other.pmi):
+//   "PMI" version 1, u64 hash of the source, u32 function count, then per
+//   function: u16 name length, name, u8 return type, u8 parameter count and
+//   a u8 per parameter type (all integers little endian)
+// an importer reads the .pmi instead of the source. when the hash does not
+// match the source any more the interface is regenerated, which only needs the
+// module's own source: signatures are syntax, imports of imports don't matter
+class ModuleInterface {
+    public:
+    // the exported functions of a parsed module
+    static ModuleInterface of(const ProgramAST& program, llvm::StringRef source);
+
+    // the interface of the module at sourcePath, from its .pmi when that is up
+    // to date, otherwise parsed from the source and written. errors are printed
+    static std::optional<ModuleInterface> forModule(const std::string& sourcePath);
+
+    static std::optional<ModuleInterface> read(const std::string& path);
+    // the file is only replaced when its contents change
+    bool write(const std::string& path) const;
+
+    // other.pilla -> other.pmi
+    static std::string pathFor(const std::string& sourcePath);
+    // generated from exactly this source
+    bool matches(llvm::StringRef source) const;
+
+    // a prototype (FunctionAST without body) per exported function
+    std::vector<std::unique_ptr<FunctionAST>> declarations() const;
+    // the signatures without the source hash: what importers depend on
+    std::string signatures() const;
+
+    private:
+    struct Function {
+        std::string name;
+        uint8_t returnType;
+        std::vector<uint8_t> paramTypes;
+    };
+    uint64_t sourceHash = 0;
+    std::vector<Function> functions;
+};
+
+// a compiled module writes its .pmi, if it exports anything (the interface
+// of a module without exports is only written when something imports it).
+// only called once an object, bitcode or assembly file was written: --run,
+// --interpret, --tiered and -emit-llvm leave the source directory alone
+void writeInterface(const ProgramAST& program, llvm::StringRef source, const std::string& sourcePath);
+// the same for an output that came from the compile cache, without an AST:
+// parses source only when the .pmi is missing or out of date
+void refreshInterface(llvm::StringRef source, const std::string& sourcePath);
+
+// an import path as written, relative to the directory of the importing file
+std::string resolveImport(const std::string& importer, const std::string& path);
+
+// adds the prototypes of every module program imports to program.imported.
+// errors are printed, false when a module could not be loaded
+bool resolveImports(ProgramAST& program, const std::string& sourcePath);
+
+// the signatures of every module the source imports, for keys of caches that
+// skip parsing (the source is only lexed). empty without imports
+std::string importedSignatures(const std::string& source, const std::string& sourcePath);
+
+#endif //PILLA_MODULEINTERFACE_H
@@ -17,6 +17,10 @@ class Parser {
     // returns the root node of thr AST
     std::unique_ptr<ProgramAST> parse();
 
+    // the tokens are exactly one function (plus E_O_F), used by the query
+    // engine. nullptr and the message in error on a syntax error
+    std::unique_ptr<FunctionAST> parseSingleFunction(std::string& error);
+
     private:
     std::vector<Token> tokens;
     size_t current =0;
@@ -26,6 +30,9 @@ class Parser {
     // parses function
     std::unique_ptr<FunctionAST> parseFunction();
 
+    // parses an import declaration, returns the module path
+    std::string parseImport();
+
     // parse statement
     std::unique_ptr<StmtAST> parseStatement();
                             
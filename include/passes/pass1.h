@@ -4,20 +4,63 @@
 #include "llvm/IR/Function.h"
 #include "llvm/IR/PassManager.h"
 #include "llvm/Passes/PassBuilder.h"
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
 // #include "llvm/Passes/PassPlugin.h"
 
 
 namespace llvm {
 
+    // instruction mix of a single function
+    struct IRStats {
+        std::map<std::string, unsigned> opcodes; // opcode name -> count
+        unsigned basicBlocks = 0;
+        unsigned instructions = 0;
+        unsigned allocas = 0;
+        unsigned loads = 0;
+        unsigned stores = 0;
+        unsigned calls = 0;
+        unsigned loops = 0;
+
+        void add(const IRStats& other);
+    };
+
+    // function analysis computing the IRStats, cached by the analysis manager
+    // until a pass changes the function
+    class IRStatsAnalysis : public AnalysisInfoMixin<IRStatsAnalysis> {
+        friend AnalysisInfoMixin<IRStatsAnalysis>;
+        static AnalysisKey Key;
+
+       public :
+        using Result = IRStats;
+        Result run(Function &F, FunctionAnalysisManager &AM);
+    };
+
+    // keeps the stats of every function after each pipeline stage (--ir-stats)
+    class IRStatsRecorder {
+       public :
+        void record(StringRef stage, const Function &F, const IRStats &stats);
+
+        // json: one entry per stage with per function stats and totals
+        bool writeJSON(const std::string &filename) const;
+
+       private :
+        using StageStats = std::vector<std::pair<std::string, IRStats>>;
+        std::vector<std::pair<std::string, StageStats>> stages;
+    };
+
     // Define the Pass Class
+    // prints the instruction mix of every function to errs()
     class AddCounterPass : public PassInfoMixin<AddCounterPass> {
-       public : 
+       public :
         // The run method declaration
         PreservedAnalyses run(Function &F, FunctionAnalysisManager &AM);
 
         // Required static method for the new PM
         static bool isRequired() { return true; }
-        
+
     };
 
 } // namespace llvm
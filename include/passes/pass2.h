@@ -2,14 +2,19 @@
 #define LLVM_TRANSFORMS_UNUSEDARGELIMPASS_H
 
 #include "llvm/IR/Function.h"
+#include "llvm/IR/Module.h"
 #include "llvm/IR/PassManager.h"
 #include "llvm/Passes/PassBuilder.h"
 namespace llvm {
 
+    // removes arguments nobody reads and return values nobody uses.
+    // works on the whole module because every call site has to be rewritten
+    // together with the callee, so only functions with local linkage whose
+    // address is never taken are touched
     struct UnusedArgElimPass : public PassInfoMixin<UnusedArgElimPass> {
         
         // This run method modifies the IR, so it must be careful with PreservedAnalyses
-        PreservedAnalyses run(Function &F, FunctionAnalysisManager &AM);
+        PreservedAnalyses run(Module &M, ModuleAnalysisManager &AM);
 
         static bool isRequired() { return false; } // Not a required pass
     };
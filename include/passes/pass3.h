@@ -0,0 +1,36 @@
+#ifndef LLVM_TRANSFORMS_TIERINSTRUMENTPASS_H
+#define LLVM_TRANSFORMS_TIERINSTRUMENTPASS_H
+
+#include "llvm/IR/Module.h"
+#include "llvm/IR/PassManager.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace llvm {
+
+    // prepares the fast start tier of --tiered.
+    // every defined function gets
+    //   __pilla_count.<name>: i64 counter, bumped on entry and on every loop back edge
+    //   __pilla_calls.<name>: i64 counter, bumped on entry only (the entry count tier 2 uses)
+    //   __pilla_tier.<name>:  pointer to the code to run, initially the function itself
+    // all direct calls load the pointer and call through it, so swapping the
+    // pointer replaces the function. when a counter reaches the threshold
+    // __pilla_tier_up(id) is called once, id is the index in instrumented()
+    class TierInstrumentPass : public PassInfoMixin<TierInstrumentPass> {
+       public :
+        TierInstrumentPass(uint64_t threshold, std::vector<std::string>* instrumented)
+            : threshold(threshold), instrumented(instrumented) {}
+
+        PreservedAnalyses run(Module &M, ModuleAnalysisManager &AM);
+
+        static bool isRequired() { return true; }
+
+       private :
+        uint64_t threshold;
+        std::vector<std::string>* instrumented;
+    };
+
+} // namespace llvm
+
+#endif // LLVM_TRANSFORMS_TIERINSTRUMENTPASS_H
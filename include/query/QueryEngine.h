@@ -0,0 +1,93 @@
+#ifndef PILLA_QUERYENGINE_H
+#define PILLA_QUERYENGINE_H
+
+#include "lexer/Token.h"
+#include "parser/AST.h"
+#include "sema/Sema.h"
+#include "llvm/Support/raw_ostream.h"
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+// the front end as memoized queries, for long lived processes (--serve --check,
+// --watch) that see the same file again after an edit:
+//   tokens-of-file          the Lexer over the file text
+//   ast-of-function         the Parser over the tokens of one function
+//   signature-of-function   return and parameter types, taken from the AST
+//   types-of-function-body  Semantics on one body
+// a function's AST is keyed by its tokens without their positions, so it is
+// reused when only other functions (or whitespace and comments) changed. a
+// body's types depend on its AST and on the signatures of the functions it
+// looked up, so editing the body of a callee does not re-run its callers.
+// imported signatures come from the interface files (.pmi) on every check.
+// results are kept until the next setFileText of the file. not thread safe
+class QueryEngine {
+    public:
+    // the only input. nothing runs until a query asks for it
+    void setFileText(const std::string& path, const std::string& text);
+    bool hasFile(const std::string& path) const { return files.count(path) != 0; }
+
+    // tokens-of-file
+    const std::vector<Token>& tokensOf(const std::string& path);
+    // ast-of-function for every function of the file: the functions that
+    // parsed, in source order. the ProgramAST stays owned by the engine, its
+    // imports are only filled in by check
+    ProgramAST& programOf(const std::string& path);
+    // types-of-function-body for every function (the signatures as needed),
+    // then the recursive tail calls. false on any syntax or semantic error,
+    // diagnostics get "<path>:<line>: " in front, in source order
+    bool check(const std::string& path, std::vector<std::string>& diagnostics);
+
+    // what ran and what was reused since the engine was created
+    void printStats(llvm::raw_ostream& os) const;
+
+    private:
+    struct FunctionQueries {
+        // key of ast-of-function, the token types and lexemes
+        std::string tokenKey;
+        // first line in the current text, not part of any key
+        int line = 0;
+        // owned by the ProgramAST of the file, nullptr on a syntax error
+        FunctionAST* ast = nullptr;
+        std::string syntaxError;
+        // signature-of-function
+        std::string signatureKey;
+        Semantics::FunctionInfo signature;
+
+        // types-of-function-body, valid while the looked up signatures
+        // (name -> signature key, empty when it was not declared) are the same
+        bool typesValid = false;
+        bool typesOk = false;
+        std::vector<std::string> semanticErrors;
+        std::map<std::string, std::string> dependencies;
+        Semantics::CallGraph callGraph;
+        Semantics::TailCalls tailCalls;
+    };
+
+    struct FileQueries {
+        std::string text;
+        bool tokensValid = false;
+        std::vector<Token> tokens;
+        bool functionsValid = false;
+        std::vector<std::unique_ptr<FunctionQueries>> functions;
+        // import declarations: path as written and line
+        std::vector<std::pair<std::string, int>> imports;
+        std::unique_ptr<ProgramAST> program;
+    };
+
+    struct QueryStats {
+        unsigned runs = 0;
+        unsigned reused = 0;
+    };
+
+    std::map<std::string, FileQueries> files;
+    QueryStats tokenStats, astStats, signatureStats, typeStats;
+
+    FileQueries& file(const std::string& path);
+    // splits the tokens into functions and parses the ones not seen before
+    void updateFunctions(FileQueries& file);
+    void updateTypes(FileQueries& file);
+};
+
+#endif //PILLA_QUERYENGINE_H
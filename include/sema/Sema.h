@@ -2,6 +2,8 @@
 #define PILLA_SEMANTICS_H
 
 #include "parser/AST.h"
+#include <map>
+#include <set>
 #include <string>
 #include <vector>
 
@@ -10,6 +12,28 @@ class Semantics : public ASTVisitor {
     // return true if it is valid 
     bool analyze(ProgramAST& program);
 
+    // Function table
+    struct FunctionInfo {
+        Type returnType;
+        std::vector<Type> paramTypes;
+    };
+    using FunctionTable = std::vector<std::pair<std::string, FunctionInfo>>;
+    using CallGraph = std::map<std::string, std::vector<std::string>>;
+    using TailCalls = std::vector<std::pair<std::string, CallExprAST*>>;
+
+    // per function entry points for the query engine (query/QueryEngine.h)
+    static FunctionInfo signatureOf(const FunctionAST& function);
+    // analyzes one body against the given table, errors go to diagnostics
+    // instead of stderr. afterwards the accessors below describe that body
+    bool analyzeFunction(FunctionAST& function, const FunctionTable& table, std::vector<std::string>& diagnostics);
+    // functions the body looked up, including ones that were not declared
+    const std::set<std::string>& getLookups() const { return lookups; }
+    const CallGraph& getCallGraph() const { return callGraph; }
+    const TailCalls& getTailCalls() const { return tailCalls; }
+
+    // sets CallExprAST::recursive on the tail calls (needs the whole call graph)
+    static void markRecursiveTailCalls(const CallGraph& callGraph, const TailCalls& tailCalls);
+
     // visitor methods
     // visitor methods
     long visit(ProgramAST& node) override;
@@ -44,14 +68,18 @@ class Semantics : public ASTVisitor {
     void declareVariable(const std::string& name, Type type);
     Type getVariableType(const std::string& name);
     
-    // Function table
-    struct FunctionInfo {
-        Type returnType;
-        std::vector<Type> paramTypes;
-    };
-    std::vector<std::pair<std::string, FunctionInfo>> functions;
+    FunctionTable functions;
+    // the table lookups go to: functions, or the one given to analyzeFunction
+    const FunctionTable* declared = &functions;
+    std::set<std::string> lookups;
+    std::vector<std::string>* diagnostics = nullptr;
     void declareFunction(const std::string& name, Type returnType, const std::vector<Type>& paramTypes);
     std::optional<FunctionInfo> getFunction(const std::string& name);
+
+    // call graph, used to find recursive tail calls
+    std::string currentFunction;
+    CallGraph callGraph;
+    TailCalls tailCalls;
 };
 
 #endif //PILLA_SEMANTICS_H
\ No newline at end of file
@@ -0,0 +1,47 @@
+#ifndef PILLA_MEMREPORT_H
+#define PILLA_MEMREPORT_H
+
+#include "llvm/ADT/StringRef.h"
+#include <cstddef>
+#include <cstdint>
+
+// allocation and peak RSS accounting behind --mem-report.
+// the compiler executable replaces operator new/delete (MemReportHooks.cpp),
+// other programs linking the library keep the default allocator and count
+// nothing. allocations are charged to the phases open on the allocating
+// thread, exclusively: a nested phase is not charged to its parent
+
+void enableMemReport();
+bool memReportEnabled();
+
+// called by the allocation hooks while the report is enabled
+void countAllocation(std::size_t usableSize);
+void countFree(std::size_t usableSize);
+
+// print the per phase table to stderr
+void printMemReport();
+
+// records the allocations made while it is alive under the given phase name
+class MemScope {
+    public:
+    MemScope(llvm::StringRef name);
+    ~MemScope();
+
+    MemScope(const MemScope&) = delete;
+    MemScope& operator=(const MemScope&) = delete;
+
+    private:
+    bool active;
+    unsigned phase = 0;
+    uint64_t allocs = 0;
+    uint64_t allocBytes = 0;
+    uint64_t freedBytes = 0;
+    long startRSS = 0;
+    // inclusive numbers of the phases nested in this one
+    uint64_t childAllocs = 0;
+    uint64_t childAllocBytes = 0;
+    uint64_t childFreedBytes = 0;
+    MemScope* parent = nullptr;
+};
+
+#endif //PILLA_MEMREPORT_H
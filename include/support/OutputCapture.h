@@ -0,0 +1,40 @@
+#ifndef PILLA_OUTPUTCAPTURE_H
+#define PILLA_OUTPUTCAPTURE_H
+
+#include "llvm/Support/raw_ostream.h"
+#include <string>
+
+// per thread redirection of std::cout and std::cerr. the compiler phases print
+// straight to the standard streams, when several files are compiled at once
+// each one captures its output and it is printed in one piece afterwards
+
+// replaces the buffers of std::cout and std::cerr, threads without a capture
+// keep writing to the terminal. call once before starting worker threads
+void installOutputCapture();
+
+// stands in for llvm::errs() in code that may run under a capture (codegen,
+// passes, caches, linking). llvm::errs() writes to fd 2 directly, this goes
+// through std::cerr and ends up with the rest of the file's output
+llvm::raw_ostream& diagnostics();
+
+// while alive, everything this thread writes to std::cout / std::cerr is kept
+class OutputCapture {
+    public:
+    OutputCapture();
+    ~OutputCapture();
+
+    OutputCapture(const OutputCapture&) = delete;
+    OutputCapture& operator=(const OutputCapture&) = delete;
+
+    const std::string& out() const { return outText; }
+    const std::string& err() const { return errText; }
+
+    private:
+    std::string outText;
+    std::string errText;
+    OutputCapture* previous = nullptr;
+
+    friend class CapturingBuffer;
+};
+
+#endif //PILLA_OUTPUTCAPTURE_H
@@ -0,0 +1,13 @@
+#ifndef PILLA_RELOCATABLELINK_H
+#define PILLA_RELOCATABLELINK_H
+
+#include "llvm/ADT/ArrayRef.h"
+#include <string>
+
+// combines objects into one relocatable object with the system linker (ld -r),
+// then makes hidden symbols local (objcopy --localize-hidden): they were only
+// shared between the pieces. errors are printed, false if there is no ld or
+// objcopy or one of them failed
+bool linkRelocatable(llvm::ArrayRef<std::string> objects, const std::string& output);
+
+#endif //PILLA_RELOCATABLELINK_H
@@ -0,0 +1,41 @@
+#ifndef PILLA_TIMING_H
+#define PILLA_TIMING_H
+
+#include "support/MemReport.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/TimeProfiler.h"
+#include "llvm/Support/Timer.h"
+#include <string>
+
+// compile time instrumentation behind -ftime-report and -ftime-trace
+
+// turn on the text summary (phase timers + per pass timings)
+void enableTimeReport();
+bool timeReportEnabled();
+
+// start recording a chrome trace, events shorter than granularity (us) are dropped
+void enableTimeTrace(unsigned granularity);
+// write the recorded trace as json to the given file
+bool writeTimeTrace(const std::string& filename);
+
+// print the collected timers to stderr
+void printTimeReport();
+
+// worker threads call these around their work so their phases show up in the
+// trace as a track of their own. the text report only times the main thread
+void beginThreadTimeTrace();
+void endThreadTimeTrace();
+
+// marks one compiler phase, shows up in the trace, the time report and the
+// memory report. detail is only used for the trace (e.g. the function name)
+class PhaseScope {
+    public:
+    PhaseScope(llvm::StringRef name, llvm::StringRef detail = "");
+
+    private:
+    llvm::TimeTraceScope trace;
+    llvm::NamedRegionTimer timer;
+    MemScope mem;
+};
+
+#endif //PILLA_TIMING_H
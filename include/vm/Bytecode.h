@@ -0,0 +1,84 @@
+#ifndef PILLA_BYTECODE_H
+#define PILLA_BYTECODE_H
+
+#include "parser/AST.h"
+#include <cstdint>
+#include <deque>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// register based bytecode for the interpreter (--interpret).
+// every function has a fixed window of registers, parameters are the first
+// registers of the window. operands are register numbers unless noted
+
+// one entry per opcode, keeps the enum, the names and the dispatch table in sync
+#define PILLA_OPCODES(X) \
+    X(Mov)          /* a = b */ \
+    X(LoadK)        /* a = constants[bc] */ \
+    X(IntToFloat)   /* a = (double)b */ \
+    X(AddI) X(SubI) X(MulI) X(DivI) X(ModI) /* a = b op c */ \
+    X(LtI) X(GtI) X(LeI) X(GeI) X(EqI) X(NeI) \
+    X(AddF) X(SubF) X(MulF) X(DivF) X(ModF) \
+    X(LtF) X(GtF) X(LeF) X(GeF) X(EqF) X(NeF) /* float compares give 0.0 / 1.0 */ \
+    X(Jump)         /* pc = bc */ \
+    X(JumpIfZero)   /* if a == 0 pc = bc */ \
+    X(JumpIfZeroF)  /* if a == 0.0 pc = bc */ \
+    X(Call)         /* a = functions[c](b, b+1, ...) */ \
+    X(TailCall)     /* return functions[c](b, b+1, ...) reusing the frame */ \
+    X(Return)       /* return a */ \
+    X(ReturnVoid) \
+    X(Print)        /* a = printf of b, b+1, ... formatted as formats[c] */
+
+enum class Opcode : uint16_t {
+#define PILLA_OPCODE_ENUM(name) name,
+    PILLA_OPCODES(PILLA_OPCODE_ENUM)
+#undef PILLA_OPCODE_ENUM
+};
+
+const char* opcodeName(Opcode op);
+
+// 8 bytes per instruction, jump targets and constant indices use b and c as one 32 bit operand
+struct Instruction {
+    Opcode op;
+    uint16_t a = 0;
+    uint16_t b = 0;
+    uint16_t c = 0;
+
+    uint32_t wide() const { return ((uint32_t)b << 16) | c; }
+    void setWide(uint32_t value) {
+        b = value >> 16;
+        c = value & 0xffff;
+    }
+};
+
+// a register holds one of these, the compiler knows which from the types
+union VMValue {
+    int64_t i;   // int and char
+    double f;    // float and double
+    const char* s;
+};
+
+struct BytecodeFunction {
+    std::string name;
+    unsigned numParams = 0;
+    std::vector<Type> paramTypes;
+    unsigned numRegs = 1;
+    Type returnType = Type::Void;
+    std::vector<Instruction> code;
+};
+
+struct BytecodeProgram {
+    std::vector<BytecodeFunction> functions;
+    std::vector<VMValue> constants;
+    // argument kinds of each print: 'i' int, 'f' float, 'c' char, 's' string
+    std::vector<std::string> formats;
+    // backing store of the string constants (deque: pointers stay valid)
+    std::deque<std::string> strings;
+    int mainFunction = -1;
+
+    // human readable listing, for debugging
+    void dump(std::ostream& os) const;
+};
+
+#endif //PILLA_BYTECODE_H
@@ -0,0 +1,64 @@
+#ifndef PILLA_BYTECODECOMPILER_H
+#define PILLA_BYTECODECOMPILER_H
+
+#include "vm/Bytecode.h"
+#include "parser/AST.h"
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+// lowers the checked AST (after Semantics) to bytecode, the interpreter's
+// counterpart of Codegen
+class BytecodeCompiler : public ASTVisitor {
+    public:
+    // nullptr if the program uses something the interpreter cannot run
+    std::unique_ptr<BytecodeProgram> compile(ProgramAST& program);
+
+    long visit(ProgramAST& node) override;
+    long visit(FunctionAST& node) override;
+    long visit(VariableDeclAST& node) override;
+    long visit(ReturnStmtAST& node) override;
+    long visit(PrintStmtAST& node) override;
+    long visit(IfStmtAST& node) override;
+    long visit(WhileStmtAST& node) override;
+    long visit(ForStmtAST& node) override;
+    long visit(NumberExprAST& node) override;
+    long visit(VariableExprAST& node) override;
+    long visit(CallExprAST& node) override;
+    long visit(BinaryExprAST& node) override;
+    long visit(FloatExprAST& node) override;
+    long visit(StringExprAST& node) override;
+    long visit(CharExprAST& node) override;
+
+    private:
+    std::unique_ptr<BytecodeProgram> program;
+    BytecodeFunction* function = nullptr;
+    std::map<std::string, unsigned> functionIndex;
+    std::map<std::string, std::pair<uint16_t, Type>> variables;
+    bool hasError = false;
+
+    // registers below firstTemp belong to variables, temporaries are
+    // allocated above and released after every statement
+    unsigned firstTemp = 0;
+    unsigned nextReg = 0;
+
+    // result of the last expression (like Codegen::lastValue)
+    uint16_t lastReg = 0;
+    Type lastType = Type::Void;
+
+    void error(const std::string& message);
+    uint16_t allocReg();
+    void emit(Opcode op, uint16_t a = 0, uint16_t b = 0, uint16_t c = 0);
+    size_t emitJump(Opcode op, uint16_t a = 0);
+    void patchJump(size_t at);
+    void loadConstant(VMValue value, Type type);
+    // moves (and converts) reg into dest
+    void moveTo(uint16_t dest, Type destType, uint16_t reg, Type type);
+    // evaluates a condition and emits the jump taken when it is false
+    size_t condition(ExprAST& expr);
+    void statements(std::vector<std::unique_ptr<StmtAST>>& body);
+};
+
+#endif //PILLA_BYTECODECOMPILER_H
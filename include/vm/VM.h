@@ -0,0 +1,22 @@
+#ifndef PILLA_VM_H
+#define PILLA_VM_H
+
+#include "vm/Bytecode.h"
+#include <cstddef>
+
+// interpreter for BytecodeProgram. dispatch is threaded (computed goto) with
+// gcc and clang, a switch everywhere else
+class VM {
+    public:
+    // runs main, exitCode is main's result (0 for void main).
+    // false on a runtime error (division by zero, stack overflow)
+    bool run(const BytecodeProgram& program, int& exitCode);
+
+    private:
+    // registers of all active frames
+    static constexpr size_t stackSize = 1 << 20;
+
+    void runtimeError(const BytecodeFunction& function, const char* message);
+};
+
+#endif //PILLA_VM_H
@@ -7,14 +7,49 @@
 #include "llvm/Transforms/Utils/Mem2Reg.h"
 #include "llvm/Transforms/Scalar/Reassociate.h"
 #include "llvm/Transforms/Scalar/SimplifyCFG.h"
+#include "llvm/Transforms/Scalar/TailRecursionElimination.h"
 #include "llvm/Analysis/TargetLibraryInfo.h"
+#include "llvm/Passes/PassPlugin.h"
+#include "llvm/Analysis/InlineCost.h"
+#include "llvm/Analysis/ModuleSummaryAnalysis.h"
+#include "llvm/Transforms/IPO/ArgumentPromotion.h"
+#include "llvm/Transforms/IPO/GlobalDCE.h"
+#include "llvm/Transforms/IPO/Inliner.h"
+#include "llvm/Transforms/IPO/SCCP.h"
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/Linker/Linker.h"
+#include "llvm/CodeGen/ParallelCG.h"
+#include "support/RelocatableLink.h"
+#include "support/OutputCapture.h"
+#include "support/Timing.h"
+#include <algorithm>
 #include <iostream>
+#include <thread>
 
-Codegen::Codegen() {
+Codegen::Codegen(const CodegenOptions& options)
+    : options(options), pb(nullptr, llvm::PipelineTuningOptions(), std::nullopt, &pic) {
     context = std::make_unique<llvm::LLVMContext>();
     module = std::make_unique<llvm::Module>("pilla-module", *context);
     builder = std::make_unique<llvm::IRBuilder<>>(*context);
 
+    // hooks the pass timers (-ftime-report) and trace events (-ftime-trace) into every pass run
+    si = std::make_unique<llvm::StandardInstrumentations>(*context, false);
+    si->registerCallbacks(pic, &mam);
+
+    // plugins register their callbacks before the analyses and the pipeline are set up
+    for (const auto& path : options.passPlugins) {
+        auto plugin = llvm::PassPlugin::Load(path);
+        if (!plugin) {
+            diagnostics() << "Error: could not load pass plugin '" << path << "': "
+                         << llvm::toString(plugin.takeError()) << "\n";
+            pipelineOk = false;
+            continue;
+        }
+        plugin->registerPassBuilderCallbacks(pb);
+    }
+    registerPillaPasses();
+
     // Register analysis managers
     pb.registerModuleAnalyses(mam);
     pb.registerCGSCCAnalyses(cgam);
@@ -22,28 +57,109 @@ Codegen::Codegen() {
     pb.registerLoopAnalyses(lam);
     pb.crossRegisterProxies(lam, fam, cgam, mam);
 
-    // Add passes
-    mpm.addPass(createModuleToFunctionPassAdaptor(llvm::UnusedArgElimPass()));
-    mpm.addPass(createModuleToFunctionPassAdaptor(llvm::AddCounterPass()));
+    if (!options.irStatsFile.empty()) {
+        irStats = std::make_unique<llvm::IRStatsRecorder>();
+    }
+
+    if (!options.optimize) {
+        return;
+    }
+
+    // -passes replaces the whole pipeline, nothing runs per function while emitting
+    if (!options.passPipeline.empty()) {
+        if (auto err = pb.parsePassPipeline(mpm, options.passPipeline)) {
+            diagnostics() << "Error: invalid pass pipeline '" << options.passPipeline << "': "
+                         << llvm::toString(std::move(err)) << "\n";
+            pipelineOk = false;
+        }
+        return;
+    }
+
+    // per function mode simplifies every function right after it is emitted,
+    // whole module mode leaves all of it to the module pipeline
+    if (!options.wholeModule) {
+        addFunctionPasses(fpm);
+    }
+
+    // inliner: SCCs are visited in post order, so callees are simplified
+    // before their callers decide whether to inline them
+    llvm::ModuleInlinerWrapperPass inliner(llvm::getInlineParams(2));
+    inliner.getPM().addPass(llvm::ArgumentPromotionPass());
+    llvm::FunctionPassManager functionPasses;
+    addFunctionPasses(functionPasses);
+    inliner.getPM().addPass(llvm::createCGSCCToFunctionPassAdaptor(std::move(functionPasses)));
+    mpm.addPass(std::move(inliner));
+
+    // interprocedural constant propagation, then drop what became dead
+    mpm.addPass(llvm::IPSCCPPass());
+    mpm.addPass(llvm::UnusedArgElimPass());
+    mpm.addPass(llvm::GlobalDCEPass());
+}
+
+void Codegen::addFunctionPasses(llvm::FunctionPassManager& passes) {
     // Promote allocas to registers
-    fpm.addPass(llvm::PromotePass());
+    passes.addPass(llvm::PromotePass());
     // Peephole optimizations
-    fpm.addPass(llvm::InstCombinePass());
+    passes.addPass(llvm::InstCombinePass());
     // Reassociate expressions
-    fpm.addPass(llvm::ReassociatePass());
+    passes.addPass(llvm::ReassociatePass());
     // CSE
-    fpm.addPass(llvm::GVNPass());
+    passes.addPass(llvm::GVNPass());
+    // Self recursive tail calls into loops
+    passes.addPass(llvm::TailCallElimPass());
     // Simplify control flow
-    fpm.addPass(llvm::SimplifyCFGPass());
+    passes.addPass(llvm::SimplifyCFGPass());
+}
 
-    // pilla passes
-    
+std::string Codegen::pipelineKey() const {
+    std::string key = "whole-module=" + std::to_string(options.wholeModule) + ";passes=" + options.passPipeline;
+    for (const auto& plugin : options.passPlugins) {
+        key += ";plugin=" + plugin;
+    }
+    return key;
+}
 
+void Codegen::registerPillaPasses() {
+    pb.registerAnalysisRegistrationCallback([](llvm::FunctionAnalysisManager& fam) {
+        fam.registerPass([] { return llvm::IRStatsAnalysis(); });
+    });
+    pb.registerPipelineParsingCallback(
+        [](llvm::StringRef name, llvm::FunctionPassManager& fpm,
+           llvm::ArrayRef<llvm::PassBuilder::PipelineElement>) {
+            if (name == "add-counter") {
+                fpm.addPass(llvm::AddCounterPass());
+                return true;
+            }
+            return false;
+        });
+    pb.registerPipelineParsingCallback(
+        [](llvm::StringRef name, llvm::ModulePassManager& mpm,
+           llvm::ArrayRef<llvm::PassBuilder::PipelineElement>) {
+            if (name == "unused-arg-elim") {
+                mpm.addPass(llvm::UnusedArgElimPass());
+                return true;
+            }
+            return false;
+        });
 }
 
 void Codegen::generate(ProgramAST& program) {
     program.accept(*this);
-    module->print(llvm::errs(), nullptr);
+    module->print(diagnostics(), nullptr);
+}
+
+llvm::orc::ThreadSafeModule Codegen::takeModule() {
+    // cached analyses point into the module, drop them before it goes away
+    lam.clear();
+    fam.clear();
+    cgam.clear();
+    mam.clear();
+    return llvm::orc::ThreadSafeModule(std::move(module), std::move(context));
+}
+
+void Codegen::recordIRStats(llvm::StringRef stage, llvm::Function& function) {
+    if (!irStats || function.isDeclaration()) return;
+    irStats->record(stage, function, fam.getResult<llvm::IRStatsAnalysis>(function));
 }
 
 llvm::Value* Codegen::logError(const char* str) {
@@ -51,83 +167,158 @@ llvm::Value* Codegen::logError(const char* str) {
     return nullptr;
 }
 
+void Codegen::logWarning(const std::string& str) {
+    std::cerr << "Codegen Warning: " << str << std::endl;
+}
+
 void Codegen::initializeTargets() {
     llvm::InitializeNativeTarget();
     llvm::InitializeNativeTargetAsmParser();
     llvm::InitializeNativeTargetAsmPrinter();
 }
 
-void Codegen::emitObjectCode(const std::string& filename) {
+llvm::TargetMachine* Codegen::hostTargetMachine() {
+    // creating one is not free, batch workers and the compile server reuse one
+    // per thread (a target machine can't be used by two threads at once)
+    thread_local std::unique_ptr<llvm::TargetMachine> targetMachine;
+    if (targetMachine) return targetMachine.get();
+
     // Get target triple
     llvm::Triple targetTriple(llvm::sys::getDefaultTargetTriple());
-    module->setTargetTriple(targetTriple);
-    
+
     // Get target
     std::string error;
     auto target = llvm::TargetRegistry::lookupTarget(targetTriple.str(), error);
-    
+
     if (!target) {
-        llvm::errs() << "Error: " << error << "\n";
-        return;
+        diagnostics() << "Error: " << error << "\n";
+        return nullptr;
     }
-    
+
     // Create target machine
     auto CPU = "generic";
     auto features = "";
     llvm::TargetOptions opt;
     auto RM = llvm::Reloc::Model::PIC_;
-    auto targetMachine = target->createTargetMachine(
-        targetTriple, CPU, features, opt, RM);
+    targetMachine.reset(target->createTargetMachine(targetTriple, CPU, features, opt, RM));
+    return targetMachine.get();
+}
+
+bool Codegen::emitObjectCode(const std::string& filename) {
+    if (!generateOk) return false;
+    PhaseScope phase("Backend", filename);
+
+    llvm::TargetMachine* targetMachine = hostTargetMachine();
+    if (!targetMachine) return false;
     
     // Configure module
+    module->setTargetTriple(targetMachine->getTargetTriple());
     module->setDataLayout(targetMachine->createDataLayout());
+
+    if (options.backendThreads > 1) {
+        // one more target machine with the same configuration per partition
+        return emitObjectCodeParallel(filename, [targetMachine] {
+            return std::unique_ptr<llvm::TargetMachine>(targetMachine->getTarget().createTargetMachine(
+                targetMachine->getTargetTriple(), targetMachine->getTargetCPU(),
+                targetMachine->getTargetFeatureString(), targetMachine->Options, llvm::Reloc::Model::PIC_));
+        });
+    }
     
     // Emit object file
     std::error_code EC;
     llvm::raw_fd_ostream dest(filename, EC, llvm::sys::fs::OF_None);
     
     if (EC) {
-        llvm::errs() << "Could not open file: " << EC.message() << "\n";
-        return;
+        diagnostics() << "Could not open file: " << EC.message() << "\n";
+        return false;
     }
     
-    llvm::legacy::PassManager pass;
-    auto fileType = llvm::CodeGenFileType::ObjectFile;
-    
-    if (targetMachine->addPassesToEmitFile(pass, dest, nullptr, fileType)) {
-        llvm::errs() << "TargetMachine can't emit a file of this type\n";
-        return;
+    if (!emitObjectTo(*targetMachine, dest)) {
+        return false;
     }
-    
-    pass.run(*module);
     dest.flush();
     
     std::cout << "Object file written to: " << filename << "\n";
+    return true;
 }
 
-void Codegen::emitAssembly(const std::string& filename) {
-    // Get target triple
-    llvm::Triple targetTriple(llvm::sys::getDefaultTargetTriple());
-    module->setTargetTriple(targetTriple);
-    
-    // Get target
-    std::string error;
-    auto target = llvm::TargetRegistry::lookupTarget(targetTriple.str(), error);
+bool Codegen::emitObjectCode(llvm::SmallVectorImpl<char>& buffer) {
+    if (!generateOk) return false;
+    PhaseScope phase("Backend", module->getName());
+
+    llvm::TargetMachine* targetMachine = hostTargetMachine();
+    if (!targetMachine) return false;
+
+    module->setTargetTriple(targetMachine->getTargetTriple());
+    module->setDataLayout(targetMachine->createDataLayout());
+
+    llvm::raw_svector_ostream dest(buffer);
+    return emitObjectTo(*targetMachine, dest);
+}
+
+bool Codegen::emitObjectTo(llvm::TargetMachine& targetMachine, llvm::raw_pwrite_stream& dest) {
+    llvm::legacy::PassManager pass;
+    auto fileType = llvm::CodeGenFileType::ObjectFile;
     
-    if (!target) {
-        llvm::errs() << "Error: " << error << "\n";
-        return;
+    if (targetMachine.addPassesToEmitFile(pass, dest, nullptr, fileType)) {
+        diagnostics() << "TargetMachine can't emit a file of this type\n";
+        return false;
     }
     
-    // Create target machine
-    auto CPU = "generic";
-    auto features = "";
-    llvm::TargetOptions opt;
-    auto RM = llvm::Reloc::Model::PIC_;
-    auto targetMachine = target->createTargetMachine(
-        targetTriple, CPU, features, opt, RM);
+    pass.run(*module);
+    return true;
+}
+
+bool Codegen::emitObjectCodeParallel(
+    const std::string& filename,
+    const std::function<std::unique_ptr<llvm::TargetMachine>()>& createTargetMachine) {
+    // one scratch object per partition
+    std::vector<llvm::SmallString<128>> paths(options.backendThreads);
+    std::vector<std::unique_ptr<llvm::raw_fd_ostream>> files;
+    std::vector<llvm::raw_pwrite_stream*> streams;
+    auto removeParts = [&] {
+        files.clear();
+        for (const auto& path : paths) {
+            if (!path.empty()) llvm::sys::fs::remove(path);
+        }
+    };
+    for (auto& path : paths) {
+        int fd;
+        if (std::error_code EC = llvm::sys::fs::createTemporaryFile("pilla-part", "o", fd, path)) {
+            diagnostics() << "Could not create temporary file: " << EC.message() << "\n";
+            removeParts();
+            return false;
+        }
+        files.push_back(std::make_unique<llvm::raw_fd_ostream>(fd, true));
+        streams.push_back(files.back().get());
+    }
+
+    // splits the module along the call graph (locals used across partitions
+    // are externalized) and runs one target machine per partition and thread
+    llvm::splitCodeGen(*module, streams, {}, createTargetMachine, llvm::CodeGenFileType::ObjectFile);
+    files.clear();
+
+    // combine the partitions into the one object the user asked for
+    std::vector<std::string> objects(paths.begin(), paths.end());
+    bool linked = linkRelocatable(objects, filename);
+    removeParts();
+    if (!linked) {
+        return false;
+    }
+
+    std::cout << "Object file written to: " << filename << " (" << options.backendThreads << " partitions)\n";
+    return true;
+}
+
+bool Codegen::emitAssembly(const std::string& filename) {
+    if (!generateOk) return false;
+    PhaseScope phase("Backend", filename);
+
+    llvm::TargetMachine* targetMachine = hostTargetMachine();
+    if (!targetMachine) return false;
     
     // Configure module
+    module->setTargetTriple(targetMachine->getTargetTriple());
     module->setDataLayout(targetMachine->createDataLayout());
     
     // Emit assembly file
@@ -135,24 +326,52 @@ void Codegen::emitAssembly(const std::string& filename) {
     llvm::raw_fd_ostream dest(filename, EC, llvm::sys::fs::OF_None);
     
     if (EC) {
-        llvm::errs() << "Could not open file: " << EC.message() << "\n";
-        return;
+        diagnostics() << "Could not open file: " << EC.message() << "\n";
+        return false;
     }
     
     llvm::legacy::PassManager pass;
     auto fileType = llvm::CodeGenFileType::AssemblyFile;
     
     if (targetMachine->addPassesToEmitFile(pass, dest, nullptr, fileType)) {
-        llvm::errs() << "TargetMachine can't emit assembly\n";
-        return;
+        diagnostics() << "TargetMachine can't emit assembly\n";
+        return false;
     }
     
     pass.run(*module);
     dest.flush();
     
     std::cout << "Assembly file written to: " << filename << "\n";
+    return true;
 }
 
+bool Codegen::emitThinLTOBitcode(const std::string& filename) {
+    if (!generateOk) return false;
+    PhaseScope phase("Backend", filename);
+
+    llvm::TargetMachine* targetMachine = hostTargetMachine();
+    if (!targetMachine) return false;
+
+    // the link step creates its target machines from these
+    module->setTargetTriple(targetMachine->getTargetTriple());
+    module->setDataLayout(targetMachine->createDataLayout());
+
+    std::error_code EC;
+    llvm::raw_fd_ostream dest(filename, EC, llvm::sys::fs::OF_None);
+    if (EC) {
+        diagnostics() << "Could not open file: " << EC.message() << "\n";
+        return false;
+    }
+
+    // the thin link decides from the summaries alone which functions each
+    // module imports, it never loads the other modules' IR
+    const llvm::ModuleSummaryIndex& index = mam.getResult<llvm::ModuleSummaryIndexAnalysis>(*module);
+    llvm::WriteBitcodeToFile(*module, dest, false, &index);
+    dest.flush();
+
+    std::cout << "Bitcode file written to: " << filename << "\n";
+    return true;
+}
 
 llvm::Type* Codegen::getLLVMType(const std::string& typeName) {
     if (typeName == "int") return llvm::Type::getInt64Ty(*context);
@@ -165,16 +384,138 @@ llvm::Type* Codegen::getLLVMType(const std::string& typeName) {
 }
 
 long Codegen::visit(ProgramAST& node) {
-    for (auto& func : node.functions) {
-        func->accept(*this);
+    if (options.codegenThreads > 1) {
+        generateParallel(node);
+    } else {
+        // prototypes first, so calls can refer to functions defined further down
+        // (mutual recursion)
+        for (auto& func : node.functions) {
+            declareFunction(*func);
+        }
+        // defined by other modules, only the prototype of an exported function
+        for (auto& func : node.imported) {
+            declareFunction(*func);
+        }
+
+        for (auto& func : node.functions) {
+            func->accept(*this);
+        }
     }
 
-    mpm.run(*module, mam);
+    // with the object cache the key covers the module as it is now, a hit means
+    // the JIT loads the optimized machine code, so the module pipeline is not
+    // needed. the object is read here, the JIT never compiles a module that
+    // skipped the pipeline (and never stores it under the key)
+    bool cached = false;
+    if (options.objectCache) {
+        std::string key = options.objectCache->computeKey(*module, pipelineKey());
+        module->setModuleIdentifier(key);
+        cached = options.objectCache->load(key);
+    }
+
+    if (!cached) {
+        PhaseScope phase("ModulePipeline");
+        mpm.run(*module, mam);
+    }
+
+    if (irStats) {
+        // on a cache hit the module is unoptimized, there is nothing to record
+        if (!cached) {
+            for (auto& function : *module) {
+                recordIRStats("module-pipeline", function);
+            }
+        }
+        irStats->writeJSON(options.irStatsFile);
+    }
     
     return 0;
 }
 
-long Codegen::visit(FunctionAST& node) {
+void Codegen::generateParallel(ProgramAST& program) {
+    size_t threads = std::min<size_t>(options.codegenThreads, program.functions.size());
+    if (threads == 0) return;
+
+    // round robin keeps the partitions balanced and the output deterministic
+    // (a shared work queue would link the functions in a different order every run)
+    std::vector<std::vector<FunctionAST*>> partitions(threads);
+    for (size_t i = 0; i < program.functions.size(); i++) {
+        partitions[i % threads].push_back(program.functions[i].get());
+    }
+
+    // workers only emit and run the function pipeline, the module pipeline,
+    // the cache and --ir-stats stay with this codegen
+    CodegenOptions partitionOptions = options;
+    partitionOptions.irStatsFile.clear();
+    partitionOptions.objectCache = nullptr;
+    partitionOptions.codegenThreads = 1;
+
+    // the linker needs every module in one context, partitions come back as bitcode
+    std::vector<llvm::SmallVector<char, 0>> bitcode(threads);
+    {
+        PhaseScope phase("ParallelCodegen");
+        std::vector<std::thread> workers;
+        for (size_t t = 0; t < threads; t++) {
+            workers.emplace_back([&, t] {
+                beginThreadTimeTrace();
+                {
+                    Codegen partition(partitionOptions);
+                    partition.emitPartition(program, partitions[t]);
+                    llvm::raw_svector_ostream os(bitcode[t]);
+                    llvm::WriteBitcodeToFile(*partition.module, os);
+                }
+                endThreadTimeTrace();
+            });
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    PhaseScope phase("LinkPartitions");
+    llvm::Linker linker(*module);
+    for (size_t t = 0; t < threads; t++) {
+        auto partition = llvm::parseBitcodeFile(
+            llvm::MemoryBufferRef(llvm::StringRef(bitcode[t].data(), bitcode[t].size()), "partition"), *context);
+        if (!partition) {
+            logError(("could not read partition: " + llvm::toString(partition.takeError())).c_str());
+            generateOk = false;
+            continue;
+        }
+        if (linker.linkInModule(std::move(*partition))) {
+            logError("could not link partition");
+            generateOk = false;
+        }
+    }
+
+    // partitions had to see each other's functions, make private again what was private
+    for (auto& func : program.functions) {
+        llvm::Function* function = module->getFunction(func->name);
+        if (function && !func->exported && func->name != "main") {
+            function->setLinkage(llvm::Function::InternalLinkage);
+        }
+    }
+}
+
+void Codegen::emitPartition(ProgramAST& program, const std::vector<FunctionAST*>& partition) {
+    // bodies from other partitions are only declared here, declarations can't
+    // be internal, so everything is external until the partitions are linked
+    for (auto& func : program.functions) {
+        declareFunction(*func)->setLinkage(llvm::Function::ExternalLinkage);
+    }
+    for (auto& func : program.imported) {
+        declareFunction(*func);
+    }
+
+    for (FunctionAST* func : partition) {
+        func->accept(*this);
+    }
+}
+
+llvm::Function* Codegen::declareFunction(FunctionAST& node) {
+    if (llvm::Function* existing = module->getFunction(node.name)) {
+        return existing;
+    }
+
     //  Define function signature
     std::vector<llvm::Type*> paramTypes;
     for (const auto& param : node.parameters) {
@@ -184,7 +525,22 @@ long Codegen::visit(FunctionAST& node) {
     llvm::Type* retType = getLLVMType(node.returnType);
     llvm::FunctionType* funcType = llvm::FunctionType::get(retType, paramTypes, false);
     
-    llvm::Function* function = llvm::Function::Create(funcType, llvm::Function::ExternalLinkage, node.name, module.get());
+    // everything but main and exported functions is private to the module, so
+    // the inliner, IPSCCP and GlobalDCE may change or drop it, and it can use fastcc
+    bool external = node.exported || node.name == "main";
+    llvm::Function* function = llvm::Function::Create(funcType,
+        external ? llvm::Function::ExternalLinkage : llvm::Function::InternalLinkage, node.name, module.get());
+    if (!external) {
+        function->setCallingConv(llvm::CallingConv::Fast);
+    }
+    return function;
+}
+
+long Codegen::visit(FunctionAST& node) {
+    PhaseScope phase("CodegenFunction", node.name);
+
+    llvm::Function* function = declareFunction(node);
+    llvm::Type* retType = function->getReturnType();
     
     //Create entry block
     llvm::BasicBlock* entry = llvm::BasicBlock::Create(*context, "entry", function);
@@ -217,7 +573,12 @@ long Codegen::visit(FunctionAST& node) {
     llvm::verifyFunction(*function);
 
     // 6. Optimize function
-    fpm.run(*function, fam);
+    recordIRStats("irgen", *function);
+    if (options.optimize && options.passPipeline.empty() && !options.wholeModule) {
+        PhaseScope optPhase("FunctionPipeline", node.name);
+        fpm.run(*function, fam);
+        recordIRStats("function-pipeline", *function);
+    }
     
     return 0;
 }
@@ -241,7 +602,10 @@ long Codegen::visit(VariableDeclAST& node) {
 long Codegen::visit(ReturnStmtAST& node) {
     if (node.expression) {
         node.expression->accept(*this);
-        if (lastValue) {
+        if (lastValue && lastValue->getType()->isVoidTy()) {
+            // return of a void call
+            builder->CreateRetVoid();
+        } else if (lastValue) {
             builder->CreateRet(lastValue);
         } else {
             // Error handling?
@@ -504,7 +868,7 @@ long Codegen::visit(CallExprAST& node) {
         }
         
         // Add newline at the end
-        formatStr += "\\n";
+        formatStr += "\n";
         
         // Create global string constant for format
         llvm::Value* formatStrVal = builder->CreateGlobalStringPtr(formatStr);
@@ -545,10 +909,42 @@ long Codegen::visit(CallExprAST& node) {
         argsV.push_back(lastValue);
     }
     
-    lastValue = builder->CreateCall(callee, argsV, "calltmp");
+    llvm::CallInst* call = builder->CreateCall(callee, argsV, callee->getReturnType()->isVoidTy() ? "" : "calltmp");
+    // caller and callee have to agree on the convention
+    call->setCallingConv(callee->getCallingConv());
+    if (node.tailCall) {
+        markTailCall(call, node);
+    }
+    lastValue = call;
     return 0;
 }
 
+void Codegen::markTailCall(llvm::CallInst* call, CallExprAST& node) {
+    llvm::Function* caller = builder->GetInsertBlock()->getParent();
+    llvm::Function* callee = call->getCalledFunction();
+
+    // a plain tail call is only a hint, fine for calls that cannot recurse
+    if (!node.recursive) {
+        call->setTailCallKind(llvm::CallInst::TCK_Tail);
+        return;
+    }
+
+    // musttail guarantees the frame is reused, but needs identical prototypes
+    // and calling conventions (the ret right after it is emitted by the return)
+    if (caller->getFunctionType() == callee->getFunctionType() &&
+        caller->getCallingConv() == callee->getCallingConv()) {
+        call->setTailCallKind(llvm::CallInst::TCK_MustTail);
+        return;
+    }
+
+    call->setTailCallKind(llvm::CallInst::TCK_Tail);
+    std::string reason = caller->getCallingConv() != callee->getCallingConv()
+        ? "calling conventions differ"
+        : "prototypes differ";
+    logWarning("recursive tail call from '" + caller->getName().str() + "' to '" +
+               callee->getName().str() + "' cannot be guaranteed (" + reason + ")");
+}
+
 long Codegen::visit(BinaryExprAST& node) {
     // Handle assignment separately
     if (node.op == Tokentype::ASSIGN) {
@@ -0,0 +1,145 @@
+#include "driver/BatchCompiler.h"
+#include "lexer/Lexer.h"
+#include "parser/ModuleInterface.h"
+#include "parser/Parser.h"
+#include "sema/Sema.h"
+#include "support/OutputCapture.h"
+#include "support/Timing.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+
+BatchCompiler::BatchCompiler(const CodegenOptions& options, bool emitAssembly, unsigned jobs,
+                             CompileCache* cache)
+    : options(options), emitAssembly(emitAssembly), jobs(jobs), cache(cache) {
+    // one stats file per process, it would be overwritten by every input
+    if (!this->options.irStatsFile.empty()) {
+        std::cerr << "Warning: --ir-stats is ignored with several input files\n";
+        this->options.irStatsFile.clear();
+    }
+}
+
+std::string BatchCompiler::outputFor(const std::string& input) const {
+    if (emitAssembly) return llvm::sys::path::stem(input).str() + ".s";
+    return llvm::sys::path::stem(input).str() + (options.thinLTO ? ".bc" : ".o");
+}
+
+bool BatchCompiler::checkOutputNames(const std::vector<std::string>& inputs) const {
+    bool ok = true;
+    std::map<std::string, std::string> writers;
+    for (const auto& input : inputs) {
+        auto inserted = writers.emplace(outputFor(input), input);
+        if (!inserted.second) {
+            std::cerr << "Error: '" << inserted.first->second << "' and '" << input << "' would both be compiled to '"
+                      << inserted.first->first << "'\n";
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+int BatchCompiler::run(const std::vector<std::string>& inputs) {
+    // the tasks would race on the same file
+    if (!checkOutputNames(inputs)) return 1;
+
+    installOutputCapture();
+
+    std::atomic<unsigned> failed{0};
+    llvm::DefaultThreadPool pool(llvm::hardware_concurrency(jobs));
+    for (const auto& input : inputs) {
+        pool.async([this, &failed, input] {
+            beginThreadTimeTrace();
+            bool ok;
+            std::string out, err;
+            {
+                OutputCapture capture;
+                ok = compile(input, outputFor(input));
+                out = capture.out();
+                err = capture.err();
+            }
+            endThreadTimeTrace();
+
+            if (!ok) failed++;
+            std::lock_guard<std::mutex> lock(printMutex);
+            std::cout << out << std::flush;
+            if (!err.empty()) {
+                std::cerr << "--- " << input << " ---\n" << err << std::flush;
+            }
+        });
+    }
+    pool.wait();
+
+    std::cout << (inputs.size() - failed) << " of " << inputs.size() << " files compiled\n";
+    return failed ? 1 : 0;
+}
+
+bool BatchCompiler::compile(const std::string& input, const std::string& output) {
+    PhaseScope phase("CompileFile", input);
+
+    std::ifstream file(input);
+    if (!file.is_open()) {
+        std::cerr << "Error: Could not open file '" << input << "'\n";
+        return false;
+    }
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    std::string code = buffer.str();
+
+    std::string cacheKey;
+    if (cache) {
+        cacheKey = cache->computeKey(code, options, emitAssembly, importedSignatures(code, input));
+        if (cache->fetch(cacheKey, output)) {
+            std::cout << "Cache hit: " << output << "\n";
+            refreshInterface(code, input);
+            return true;
+        }
+    }
+
+    // same phases as a single file compile, without the token/AST/IR dumps
+    Lexer lexer(code);
+    std::vector<Token> tokens = lexer.scanTokens();
+
+    Parser parser(tokens);
+    std::unique_ptr<ProgramAST> ast = parser.parse();
+    if (!ast) {
+        std::cerr << "✗ Parsing failed!\n";
+        return false;
+    }
+    if (!resolveImports(*ast, input)) {
+        return false;
+    }
+
+    Semantics sema;
+    if (!sema.analyze(*ast)) {
+        std::cerr << "✗ Semantic analysis failed!\n";
+        return false;
+    }
+
+    Codegen codegen(options);
+    if (!codegen.pipelineValid()) {
+        std::cerr << "✗ Invalid pass pipeline!\n";
+        return false;
+    }
+    ast->accept(codegen);
+
+    bool ok;
+    if (emitAssembly) {
+        ok = codegen.emitAssembly(output);
+    } else if (options.thinLTO) {
+        ok = codegen.emitThinLTOBitcode(output);
+    } else {
+        ok = codegen.emitObjectCode(output);
+    }
+    if (ok) {
+        writeInterface(*ast, code, input);
+    }
+    if (ok && cache) {
+        cache->store(cacheKey, output);
+    }
+    return ok;
+}
@@ -0,0 +1,190 @@
+#include "driver/CompileCache.h"
+#include "support/OutputCapture.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/Support/Chrono.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/SHA256.h"
+#include <algorithm>
+#include <vector>
+
+namespace {
+    // entries are hex digests with this suffix, anything else in the directory is left alone
+    const char* entrySuffix = ".pilla-out";
+
+    // anchor for getMainExecutable
+    int mainAddress;
+}
+
+CompileCache::CompileCache(const std::string& dir, uint64_t maxBytes) : dir(dir), maxBytes(maxBytes) {
+    if (this->dir.empty()) {
+        llvm::SmallString<128> path;
+        if (!llvm::sys::path::cache_directory(path)) {
+            path = llvm::sys::path::get_separator();
+            llvm::sys::path::append(path, "tmp");
+        }
+        llvm::sys::path::append(path, "pilla");
+        this->dir = std::string(path);
+    }
+    if (auto EC = llvm::sys::fs::create_directories(this->dir)) {
+        diagnostics() << "Warning: could not create cache directory '" << this->dir << "': "
+                     << EC.message() << "\n";
+    }
+    buildId = compilerBuildId();
+}
+
+std::string CompileCache::compilerBuildId() {
+    // size and time stamp of the binary stand in for a build id, hashing the
+    // whole executable on every run would cost more than a small compile
+    std::string id = LLVM_VERSION_STRING;
+    std::string executable = llvm::sys::fs::getMainExecutable(nullptr, &mainAddress);
+    llvm::sys::fs::file_status status;
+    if (!executable.empty() && !llvm::sys::fs::status(executable, status)) {
+        id += ";" + executable + ";" + std::to_string(status.getSize()) + ";" +
+              std::to_string(llvm::sys::toTimeT(status.getLastModificationTime()));
+    }
+    return id;
+}
+
+std::string CompileCache::computeKey(llvm::StringRef source, const CodegenOptions& options,
+                                     bool emitAssembly, llvm::StringRef imports) const {
+    llvm::SHA256 hasher;
+    hasher.update(source);
+    // how the imported functions are called, not their bodies
+    hasher.update(imports);
+    hasher.update(buildId);
+
+    // flags that change the bytes of the output. the parallel modes are in
+    // there because they change the order of functions and sections
+    std::string flags = emitAssembly ? "-S" : "-c";
+    flags += ";whole-module=" + std::to_string(options.wholeModule);
+    flags += ";passes=" + options.passPipeline;
+    for (const auto& plugin : options.passPlugins) {
+        flags += ";plugin=" + plugin;
+    }
+    flags += ";codegen-threads=" + std::to_string(options.codegenThreads);
+    flags += ";backend-threads=" + std::to_string(options.backendThreads);
+    flags += ";thin-lto=" + std::to_string(options.thinLTO);
+    hasher.update(flags);
+
+    if (llvm::TargetMachine* targetMachine = Codegen::hostTargetMachine()) {
+        hasher.update(targetMachine->getTargetTriple().str());
+        hasher.update(targetMachine->getTargetCPU());
+        hasher.update(targetMachine->getTargetFeatureString());
+    }
+
+    auto digest = hasher.final();
+    return llvm::toHex(llvm::ArrayRef<uint8_t>(digest), true);
+}
+
+std::string CompileCache::pathFor(llvm::StringRef key) const {
+    llvm::SmallString<128> path(dir);
+    llvm::sys::path::append(path, key + entrySuffix);
+    return std::string(path);
+}
+
+bool CompileCache::fetch(llvm::StringRef key, const std::string& output) {
+    std::string entry = pathFor(key);
+    if (llvm::sys::fs::copy_file(entry, output)) {
+        misses++;
+        return false;
+    }
+    hits++;
+
+    // most recently used now
+    int fd;
+    if (!llvm::sys::fs::openFileForWrite(entry, fd, llvm::sys::fs::CD_OpenExisting, llvm::sys::fs::OF_Append)) {
+        llvm::sys::fs::setLastAccessAndModificationTime(fd, std::chrono::system_clock::now());
+        llvm::sys::fs::closeFile(fd);
+    }
+    return true;
+}
+
+void CompileCache::store(llvm::StringRef key, const std::string& output) {
+    // copy next to the final name and rename, a concurrent fetch never sees half a file
+    llvm::SmallString<128> tmpPath;
+    int fd;
+    if (llvm::sys::fs::createUniqueFile(pathFor(key) + ".%%%%%%.tmp", fd, tmpPath)) {
+        return;
+    }
+    llvm::sys::fs::closeFile(fd);
+    if (llvm::sys::fs::copy_file(output, tmpPath) || llvm::sys::fs::rename(tmpPath, pathFor(key))) {
+        llvm::sys::fs::remove(tmpPath);
+        return;
+    }
+    stores++;
+    evict();
+}
+
+namespace {
+    uint64_t directorySize(const std::string& dir) {
+        uint64_t total = 0;
+        std::error_code EC;
+        for (llvm::sys::fs::directory_iterator it(dir, EC), end; it != end && !EC; it.increment(EC)) {
+            llvm::sys::fs::file_status status;
+            if (!llvm::sys::fs::status(it->path(), status)) total += status.getSize();
+        }
+        return total;
+    }
+}
+
+uint64_t CompileCache::evict() {
+    std::lock_guard<std::mutex> lock(evictMutex);
+
+    struct Entry {
+        std::string path;
+        uint64_t size;
+        llvm::sys::TimePoint<> lastUse;
+    };
+    std::vector<Entry> entries;
+    uint64_t total = 0;
+    std::error_code EC;
+    for (llvm::sys::fs::directory_iterator it(dir, EC), end; it != end && !EC; it.increment(EC)) {
+        if (!llvm::StringRef(it->path()).ends_with(entrySuffix)) continue;
+        llvm::sys::fs::file_status status;
+        if (llvm::sys::fs::status(it->path(), status)) continue;
+        entries.push_back({it->path(), status.getSize(), status.getLastModificationTime()});
+        total += status.getSize();
+    }
+    // the ThinLTO entries are pruned by the link, here they only take up room
+    total += directorySize(getThinLTODir());
+    if (total <= maxBytes) return total;
+
+    // least recently used first
+    std::sort(entries.begin(), entries.end(),
+              [](const Entry& a, const Entry& b) { return a.lastUse < b.lastUse; });
+    for (const auto& entry : entries) {
+        if (total <= maxBytes) break;
+        if (!llvm::sys::fs::remove(entry.path)) {
+            total -= entry.size;
+            evictions++;
+        }
+    }
+    return total;
+}
+
+uint64_t CompileCache::thinLTOBudget() {
+    uint64_t total = evict();
+    uint64_t thinLTO = directorySize(getThinLTODir());
+    uint64_t own = total > thinLTO ? total - thinLTO : 0;
+    return maxBytes > own ? maxBytes - own : 0;
+}
+
+void CompileCache::printStats(llvm::raw_ostream& os) {
+    uint64_t size = evict();
+    unsigned lookups = hits + misses;
+    os << "Compile cache: " << dir << "\n";
+    os << "  hits:      " << hits << " of " << lookups << " lookups";
+    if (lookups) {
+        os << " (" << (hits * 100 / lookups) << "%)";
+    }
+    os << "\n";
+    os << "  misses:    " << misses << "\n";
+    os << "  stores:    " << stores << "\n";
+    os << "  evictions: " << evictions << "\n";
+    os << "  size:      " << llvm::format("%.1f", size / (1024.0 * 1024.0)) << " MB of "
+       << llvm::format("%.1f", maxBytes / (1024.0 * 1024.0)) << " MB\n";
+}
@@ -0,0 +1,260 @@
+#include "driver/CompileServer.h"
+#include "driver/BatchCompiler.h"
+#include "driver/DriverOptions.h"
+#include "support/OutputCapture.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/raw_os_ostream.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace {
+    volatile std::sig_atomic_t stopRequested = 0;
+
+    void requestStop(int) {
+        stopRequested = 1;
+    }
+
+    bool socketAddress(const std::string& path, sockaddr_un& address) {
+        std::memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(address.sun_path)) {
+            std::cerr << "Error: socket path '" << path << "' is too long\n";
+            return false;
+        }
+        std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+        return true;
+    }
+
+    bool writeAll(int fd, const std::string& data) {
+        size_t written = 0;
+        while (written < data.size()) {
+            // a client that went away must not kill the server with SIGPIPE
+            ssize_t n = send(fd, data.data() + written, data.size() - written, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            written += n;
+        }
+        return true;
+    }
+
+    // both sides send one message and close (or shut down) their end
+    std::string readAll(int fd) {
+        std::string data;
+        char buffer[4096];
+        for (;;) {
+            ssize_t n = read(fd, buffer, sizeof(buffer));
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) break;
+            data.append(buffer, n);
+        }
+        return data;
+    }
+}
+
+CompileServer::CompileServer(const std::string& socketPath, unsigned jobs)
+    : socketPath(socketPath), jobs(jobs) {}
+
+int CompileServer::run() {
+    sockaddr_un address;
+    if (!socketAddress(socketPath, address)) return 1;
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) {
+        std::cerr << "Error: could not create socket: " << std::strerror(errno) << "\n";
+        return 1;
+    }
+    // a socket left behind by a server that did not shut down cleanly
+    unlink(socketPath.c_str());
+    if (bind(listener, (sockaddr*)&address, sizeof(address)) < 0 || listen(listener, SOMAXCONN) < 0) {
+        std::cerr << "Error: could not listen on '" << socketPath << "': " << std::strerror(errno) << "\n";
+        close(listener);
+        return 1;
+    }
+
+    // no SA_RESTART, so a signal interrupts accept and the loop can stop
+    struct sigaction action;
+    std::memset(&action, 0, sizeof(action));
+    action.sa_handler = requestStop;
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+
+    installOutputCapture();
+    std::cout << "Compile server listening on " << socketPath << std::endl;
+
+    llvm::DefaultThreadPool pool(llvm::hardware_concurrency(jobs));
+    while (!stopRequested) {
+        int connection = accept(listener, nullptr, nullptr);
+        if (connection < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "Error: accept failed: " << std::strerror(errno) << "\n";
+            break;
+        }
+        pool.async([this, connection] {
+            handle(connection);
+            close(connection);
+        });
+    }
+
+    // requests in flight still get their answer
+    pool.wait();
+    close(listener);
+    unlink(socketPath.c_str());
+    std::cout << "Compile server stopped" << std::endl;
+    return 0;
+}
+
+void CompileServer::handle(int connection) {
+    std::istringstream request(readAll(connection));
+    std::string line;
+    if (!std::getline(request, line) || line != "pilla 1") {
+        writeAll(connection, "1 0\nError: not a pilla compile request\n");
+        return;
+    }
+    std::string workingDir;
+    std::getline(request, workingDir);
+    std::vector<std::string> args;
+    while (std::getline(request, line)) {
+        args.push_back(line);
+    }
+
+    int exitCode;
+    std::string out, err;
+    {
+        OutputCapture capture;
+        exitCode = compile(workingDir, args);
+        out = capture.out();
+        err = capture.err();
+    }
+    writeAll(connection, std::to_string(exitCode) + " " + std::to_string(out.size()) + "\n" + out + err);
+}
+
+int CompileServer::compile(const std::string& workingDir, const std::vector<std::string>& args) {
+    DriverOptions options;
+    if (!parseDriverOptions(args, options)) {
+        return 1;
+    }
+    // paths are relative to the client, not to the server
+    makePathsAbsolute(options, workingDir);
+    if (options.inputFiles.empty()) {
+        std::cerr << "Error: no input file\n";
+        return 1;
+    }
+    if (options.checkOnly) {
+        return check(options);
+    }
+    if (options.runJIT || options.tiered || options.interpretMode || options.emitLLVMOnly) {
+        std::cerr << "Error: the compile server only writes object and assembly files\n";
+        return 1;
+    }
+    if (options.inputFiles.size() > 1 && !options.outputFile.empty()) {
+        std::cerr << "Error: -o cannot be used with several input files\n";
+        return 1;
+    }
+
+    // the cache lives on disk, so one per request shares everything with the others
+    std::unique_ptr<CompileCache> cache;
+    if (options.compileCache) {
+        cache = std::make_unique<CompileCache>(options.compileCacheDir, options.compileCacheSize);
+    }
+
+    // a single file lands where an in process compile would put it, so the
+    // output does not depend on whether a server is running
+    if (options.inputFiles.size() == 1 && options.outputFile.empty()) {
+        options.outputFile = defaultOutputFile(options);
+    }
+
+    BatchCompiler compiler(options.codegen, options.emitAssembly, 1, cache.get());
+    if (options.outputFile.empty() && !compiler.checkOutputNames(options.inputFiles)) {
+        return 1;
+    }
+    unsigned failed = 0;
+    for (const auto& input : options.inputFiles) {
+        std::string output = options.outputFile;
+        if (output.empty()) {
+            // <stem>.o in the client's directory
+            llvm::SmallString<256> path(compiler.outputFor(input));
+            llvm::sys::fs::make_absolute(workingDir, path);
+            output = std::string(path);
+        }
+        if (!compiler.compile(input, output)) {
+            failed++;
+        }
+    }
+    if (cache && options.cacheStats) {
+        llvm::raw_os_ostream os(std::cerr);
+        cache->printStats(os);
+    }
+    return failed ? 1 : 0;
+}
+
+int CompileServer::check(const DriverOptions& options) {
+    bool ok = true;
+    std::vector<std::string> diagnostics;
+    // the engine is not thread safe, checks are short compared to compiles
+    std::lock_guard<std::mutex> lock(queriesMutex);
+    // inputs are already absolute (makePathsAbsolute)
+    for (const auto& input : options.inputFiles) {
+        std::ifstream file(input);
+        if (!file.is_open()) {
+            std::cerr << "Error: Could not open file '" << input << "'\n";
+            ok = false;
+            continue;
+        }
+        std::stringstream text;
+        text << file.rdbuf();
+        queries.setFileText(input, text.str());
+        ok = queries.check(input, diagnostics) && ok;
+    }
+    for (const auto& message : diagnostics) {
+        std::cerr << message << "\n";
+    }
+    if (options.queryStats) {
+        llvm::raw_os_ostream os(std::cerr);
+        queries.printStats(os);
+    }
+    return ok ? 0 : 1;
+}
+
+bool forwardToServer(const std::string& socketPath, const std::vector<std::string>& args, int& exitCode) {
+    llvm::SmallString<256> workingDir;
+    if (llvm::sys::fs::current_path(workingDir)) return false;
+
+    // one argument per line, anything else has to be compiled in process
+    std::string request = "pilla 1\n" + std::string(workingDir) + "\n";
+    for (const auto& arg : args) {
+        if (arg.find('\n') != std::string::npos) return false;
+        request += arg + "\n";
+    }
+
+    sockaddr_un address;
+    if (!socketAddress(socketPath, address)) return false;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return false;
+    if (connect(fd, (sockaddr*)&address, sizeof(address)) < 0 || !writeAll(fd, request)) {
+        close(fd);
+        return false;
+    }
+    shutdown(fd, SHUT_WR);
+    std::string response = readAll(fd);
+    close(fd);
+
+    size_t headerEnd = response.find('\n');
+    if (headerEnd == std::string::npos) return false;
+    std::istringstream header(response.substr(0, headerEnd));
+    size_t outSize = 0;
+    if (!(header >> exitCode >> outSize) || headerEnd + 1 + outSize > response.size()) return false;
+
+    std::cout << response.substr(headerEnd + 1, outSize) << std::flush;
+    std::cerr << response.substr(headerEnd + 1 + outSize) << std::flush;
+    return true;
+}
@@ -0,0 +1,142 @@
+#include "driver/DriverOptions.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include <algorithm>
+#include <iostream>
+#include <thread>
+
+namespace {
+    // the number after the option name, a diagnostic if there is none
+    template <typename T>
+    bool parseNumber(const std::string& arg, size_t prefixLength, T& value) {
+        if (llvm::StringRef(arg).drop_front(prefixLength).getAsInteger(10, value)) {
+            std::cerr << "Error: invalid number in '" << arg << "'\n";
+            return false;
+        }
+        return true;
+    }
+}
+
+bool parseDriverOptions(const std::vector<std::string>& args, DriverOptions& options) {
+    for (size_t i = 0; i < args.size(); i++) {
+        const std::string& arg = args[i];
+        if (arg.empty() || arg[0] != '-') {
+            options.inputFiles.push_back(arg);
+        } else if (arg == "-S") {
+            options.emitAssembly = true;
+        } else if (arg == "-emit-llvm") {
+            options.emitLLVMOnly = true;
+        } else if (arg == "-o" && i + 1 < args.size()) {
+            options.outputFile = args[++i];
+        } else if (arg == "--run") {
+            options.runJIT = true;
+        } else if (arg == "--lazy") {
+            options.runJIT = true;
+            options.lazyJIT = true;
+        } else if (arg == "--jit-cache") {
+            options.jitCache = true;
+        } else if (arg.rfind("--jit-cache=", 0) == 0) {
+            options.jitCache = true;
+            options.jitCacheDir = arg.substr(12);
+        } else if (arg == "--tiered") {
+            options.tiered = true;
+        } else if (arg.rfind("--tier-threshold=", 0) == 0) {
+            if (!parseNumber(arg, 17, options.tierThreshold)) return false;
+        } else if (arg == "--interpret") {
+            options.interpretMode = true;
+        } else if (arg == "--dump-bytecode") {
+            options.dumpBytecode = true;
+        } else if (arg == "-ftime-report") {
+            options.timeReport = true;
+        } else if (arg == "--mem-report") {
+            options.memReport = true;
+        } else if (arg.rfind("--ir-stats=", 0) == 0) {
+            options.codegen.irStatsFile = arg.substr(11);
+        } else if (arg.rfind("-j", 0) == 0 && arg.size() > 2) {
+            if (!parseNumber(arg, 2, options.codegen.backendThreads)) return false;
+            options.codegen.backendThreads = std::max(1u, options.codegen.backendThreads);
+        } else if (arg == "-fparallel-codegen") {
+            options.codegen.codegenThreads = std::max(1u, std::thread::hardware_concurrency());
+        } else if (arg.rfind("-fparallel-codegen=", 0) == 0) {
+            if (!parseNumber(arg, 19, options.codegen.codegenThreads)) return false;
+            options.codegen.codegenThreads = std::max(1u, options.codegen.codegenThreads);
+        } else if (arg == "-flto=thin") {
+            options.codegen.thinLTO = true;
+        } else if (arg == "-fwhole-module") {
+            options.codegen.wholeModule = true;
+        } else if (arg.rfind("-passes=", 0) == 0) {
+            options.codegen.passPipeline = arg.substr(8);
+        } else if (arg.rfind("-load-pass-plugin=", 0) == 0) {
+            options.codegen.passPlugins.push_back(arg.substr(18));
+        } else if (arg == "-ftime-trace") {
+            options.timeTraceFile = "-";
+        } else if (arg.rfind("-ftime-trace=", 0) == 0) {
+            options.timeTraceFile = arg.substr(13);
+        } else if (arg.rfind("-ftime-trace-granularity=", 0) == 0) {
+            if (!parseNumber(arg, 25, options.timeTraceGranularity)) return false;
+        } else if (arg == "--cache") {
+            options.compileCache = true;
+        } else if (arg.rfind("--cache=", 0) == 0) {
+            options.compileCache = true;
+            options.compileCacheDir = arg.substr(8);
+        } else if (arg.rfind("--cache-size=", 0) == 0) {
+            if (!parseNumber(arg, 13, options.compileCacheSize)) return false;
+            options.compileCacheSize *= 1024 * 1024;
+        } else if (arg == "--cache-stats") {
+            options.cacheStats = true;
+        } else if (arg == "--incremental") {
+            options.incremental = true;
+        } else if (arg.rfind("--incremental=", 0) == 0) {
+            options.incremental = true;
+            options.incrementalDir = arg.substr(14);
+        } else if (arg == "--serve" && i + 1 < args.size()) {
+            options.serveSocket = args[++i];
+        } else if (arg == "--connect" && i + 1 < args.size()) {
+            options.connectSocket = args[++i];
+        } else if (arg == "--check") {
+            options.checkOnly = true;
+        } else if (arg == "--query-stats") {
+            options.queryStats = true;
+        } else if (arg == "--watch") {
+            options.watch = true;
+        } else if (arg.rfind("--jobs=", 0) == 0) {
+            if (!parseNumber(arg, 7, options.jobs)) return false;
+        }
+    }
+    return true;
+}
+
+std::string defaultOutputFile(const DriverOptions& options, bool thinLink) {
+    if (options.emitAssembly) return "output.s";
+    return options.codegen.thinLTO && !thinLink ? "output.bc" : "output.o";
+}
+
+void makePathsAbsolute(DriverOptions& options, const std::string& dir) {
+    // empty means "not given" or "the default location", it stays empty
+    auto resolve = [&](std::string& path) {
+        if (path.empty()) return;
+        llvm::SmallString<256> result(path);
+        llvm::sys::fs::make_absolute(dir, result);
+        path = std::string(result);
+    };
+    for (auto& input : options.inputFiles) {
+        resolve(input);
+    }
+    resolve(options.outputFile);
+    resolve(options.jitCacheDir);
+    resolve(options.compileCacheDir);
+    resolve(options.incrementalDir);
+    resolve(options.codegen.irStatsFile);
+    // "-": next to the output, decided later
+    if (options.timeTraceFile != "-") {
+        resolve(options.timeTraceFile);
+    }
+    // a bare name is looked up on the library path like dlopen does
+    for (auto& plugin : options.codegen.passPlugins) {
+        if (llvm::sys::path::has_parent_path(plugin)) {
+            resolve(plugin);
+        }
+    }
+}
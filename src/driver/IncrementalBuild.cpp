@@ -0,0 +1,266 @@
+#include "driver/IncrementalBuild.h"
+#include "driver/CompileCache.h"
+#include "parser/ASTFingerprint.h"
+#include "support/OutputCapture.h"
+#include "support/RelocatableLink.h"
+#include "support/Timing.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/Linker/Linker.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/SHA256.h"
+#include <iostream>
+#include <map>
+#include <set>
+
+namespace {
+    // one function per module, the parallel modes have nothing to split. there
+    // is no module pipeline either, -fwhole-module would leave every function
+    // unoptimized (and the cached entries with it)
+    CodegenOptions perFunctionOptions(CodegenOptions options) {
+        options.codegenThreads = 1;
+        options.backendThreads = 1;
+        options.wholeModule = false;
+        options.irStatsFile.clear();
+        options.objectCache = nullptr;
+        return options;
+    }
+}
+
+IncrementalBuild::IncrementalBuild(const CodegenOptions& options)
+    : options(perFunctionOptions(options)), inMemory(true) {}
+
+IncrementalBuild::IncrementalBuild(const std::string& dir, const CodegenOptions& options)
+    : dir(dir), options(perFunctionOptions(options)) {
+    if (this->dir.empty()) {
+        llvm::SmallString<128> path;
+        if (!llvm::sys::path::cache_directory(path)) {
+            path = llvm::sys::path::get_separator();
+            llvm::sys::path::append(path, "tmp");
+        }
+        llvm::sys::path::append(path, "pilla-incremental");
+        this->dir = std::string(path);
+    }
+    if (auto EC = llvm::sys::fs::create_directories(this->dir)) {
+        diagnostics() << "Warning: could not create incremental build directory '" << this->dir << "': "
+                     << EC.message() << "\n";
+    }
+}
+
+std::string IncrementalBuild::pathFor(const std::string& key, const char* extension) const {
+    llvm::SmallString<128> path(dir);
+    llvm::sys::path::append(path, key + extension);
+    return std::string(path);
+}
+
+std::string IncrementalBuild::functionKey(ProgramAST& program, FunctionAST& function) const {
+    ASTFingerprint fingerprint;
+    llvm::SHA256 hasher;
+    hasher.update(fingerprint.of(function));
+
+    // the caller's code depends on how its callees are called (types and
+    // calling convention), not on their bodies: there is no inlining across entries
+    std::map<std::string, FunctionAST*> functions;
+    for (auto& func : program.functions) {
+        functions[func->name] = func.get();
+    }
+    for (auto& func : program.imported) {
+        functions.insert({func->name, func.get()});
+    }
+    for (const auto& callee : fingerprint.callees()) {
+        std::string signature = callee + "(";
+        auto it = functions.find(callee);
+        if (it != functions.end()) {
+            FunctionAST* declaration = it->second;
+            for (const auto& param : declaration->parameters) {
+                signature += param.first + ",";
+            }
+            signature += ")" + declaration->returnType;
+            signature += (declaration->exported || declaration->name == "main") ? " external" : " fastcc";
+        } else {
+            signature += "extern)";
+        }
+        hasher.update(signature);
+    }
+
+    std::string flags = "passes=" + options.passPipeline + ";optimize=" + std::to_string(options.optimize);
+    for (const auto& plugin : options.passPlugins) {
+        flags += ";plugin=" + plugin;
+    }
+    hasher.update(flags);
+    hasher.update(CompileCache::compilerBuildId());
+    if (llvm::TargetMachine* targetMachine = Codegen::hostTargetMachine()) {
+        hasher.update(targetMachine->getTargetTriple().str());
+        hasher.update(targetMachine->getTargetCPU());
+        hasher.update(targetMachine->getTargetFeatureString());
+    }
+
+    auto digest = hasher.final();
+    return llvm::toHex(llvm::ArrayRef<uint8_t>(digest), true);
+}
+
+bool IncrementalBuild::update(ProgramAST& program) {
+    PhaseScope phase("IncrementalUpdate");
+    keys.clear();
+    reused = 0;
+    rebuilt = 0;
+
+    for (auto& func : program.functions) {
+        std::string key = functionKey(program, *func);
+        keys.push_back(key);
+        if (hasEntry(key)) {
+            reused++;
+            continue;
+        }
+        if (!compileFunction(program, *func, key)) {
+            return false;
+        }
+        rebuilt++;
+    }
+
+    // memory only keeps what the program consists of now
+    if (inMemory) {
+        std::set<std::string> live(keys.begin(), keys.end());
+        for (auto it = entries.begin(); it != entries.end();) {
+            it = live.count(it->first) ? std::next(it) : entries.erase(it);
+        }
+    }
+    return true;
+}
+
+bool IncrementalBuild::hasEntry(const std::string& key) const {
+    if (inMemory) {
+        return entries.count(key) != 0;
+    }
+    // the object is renamed into place last, with it the entry is complete
+    return llvm::sys::fs::exists(pathFor(key, ".o"));
+}
+
+bool IncrementalBuild::compileFunction(ProgramAST& program, FunctionAST& function, const std::string& key) {
+    PhaseScope phase("IncrementalFunction", function.name);
+
+    Codegen codegen(options);
+    if (!codegen.pipelineValid()) return false;
+    codegen.emitPartition(program, {&function});
+
+    // other objects of this build are the only callers of a private function
+    if (!function.exported && function.name != "main") {
+        codegen.getModule()->getFunction(function.name)->setVisibility(llvm::GlobalValue::HiddenVisibility);
+    }
+
+    Entry entry;
+    llvm::raw_svector_ostream bitcode(entry.bitcode);
+    llvm::WriteBitcodeToFile(*codegen.getModule(), bitcode);
+    if (!codegen.emitObjectCode(entry.object)) {
+        return false;
+    }
+    return storeEntry(key, entry);
+}
+
+bool IncrementalBuild::storeEntry(const std::string& key, Entry& entry) {
+    if (inMemory) {
+        entries[key] = std::move(entry);
+        return true;
+    }
+
+    // written next to the final names and renamed, an interrupted build
+    // never leaves half an entry behind
+    std::string bitcodePath = pathFor(key, ".bc");
+    std::string objectPath = pathFor(key, ".o");
+    llvm::SmallString<128> tmpBitcode, tmpObject;
+    llvm::sys::fs::createUniquePath(bitcodePath + ".%%%%%%.tmp", tmpBitcode, false);
+    llvm::sys::fs::createUniquePath(objectPath + ".%%%%%%.tmp", tmpObject, false);
+    auto write = [](llvm::StringRef path, const llvm::SmallVectorImpl<char>& data) {
+        std::error_code EC;
+        llvm::raw_fd_ostream os(path, EC, llvm::sys::fs::OF_None);
+        if (EC) {
+            diagnostics() << "Could not open file: " << EC.message() << "\n";
+            return false;
+        }
+        os.write(data.data(), data.size());
+        return true;
+    };
+    if (!write(tmpBitcode, entry.bitcode) || !write(tmpObject, entry.object) ||
+        llvm::sys::fs::rename(tmpBitcode, bitcodePath) || llvm::sys::fs::rename(tmpObject, objectPath)) {
+        llvm::sys::fs::remove(tmpBitcode);
+        llvm::sys::fs::remove(tmpObject);
+        return false;
+    }
+    return true;
+}
+
+std::unique_ptr<llvm::MemoryBuffer> IncrementalBuild::bitcodeOf(const std::string& key) const {
+    if (inMemory) {
+        auto entry = entries.find(key);
+        if (entry == entries.end()) return nullptr;
+        const auto& bitcode = entry->second.bitcode;
+        return llvm::MemoryBuffer::getMemBuffer(llvm::StringRef(bitcode.data(), bitcode.size()), key, false);
+    }
+    auto buffer = llvm::MemoryBuffer::getFile(pathFor(key, ".bc"));
+    if (!buffer) return nullptr;
+    return std::move(*buffer);
+}
+
+bool IncrementalBuild::writeObject(const std::string& output) {
+    PhaseScope phase("IncrementalLink", output);
+    std::vector<std::string> objects;
+    // ld only reads files, objects kept in memory go to scratch files first
+    std::vector<llvm::SmallString<128>> scratch;
+    auto removeScratch = [&] {
+        for (const auto& path : scratch) {
+            llvm::sys::fs::remove(path);
+        }
+    };
+    for (const auto& key : keys) {
+        if (!inMemory) {
+            objects.push_back(pathFor(key, ".o"));
+            continue;
+        }
+        int fd;
+        scratch.emplace_back();
+        if (std::error_code EC = llvm::sys::fs::createTemporaryFile("pilla-function", "o", fd, scratch.back())) {
+            diagnostics() << "Could not create temporary file: " << EC.message() << "\n";
+            scratch.pop_back();
+            removeScratch();
+            return false;
+        }
+        const Entry& entry = entries.at(key);
+        llvm::raw_fd_ostream os(fd, true);
+        os.write(entry.object.data(), entry.object.size());
+        objects.push_back(std::string(scratch.back()));
+    }
+    bool linked = linkRelocatable(objects, output);
+    removeScratch();
+    if (!linked) {
+        return false;
+    }
+    std::cout << "Object file written to: " << output << "\n";
+    return true;
+}
+
+bool IncrementalBuild::printModule(llvm::raw_ostream& os) {
+    llvm::LLVMContext context;
+    llvm::Module module("pilla-module", context);
+    llvm::Linker linker(module);
+    for (const auto& key : keys) {
+        auto buffer = bitcodeOf(key);
+        if (!buffer) {
+            diagnostics() << "Error: missing bitcode for entry " << key << "\n";
+            return false;
+        }
+        auto function = llvm::parseBitcodeFile(buffer->getMemBufferRef(), context);
+        if (!function) {
+            diagnostics() << "Error: " << llvm::toString(function.takeError()) << "\n";
+            return false;
+        }
+        if (linker.linkInModule(std::move(*function))) {
+            return false;
+        }
+    }
+    module.print(os, nullptr);
+    return true;
+}
@@ -0,0 +1,158 @@
+#include "driver/ThinLTOLink.h"
+#include "support/OutputCapture.h"
+#include "support/RelocatableLink.h"
+#include "support/Timing.h"
+#include "llvm/BinaryFormat/Magic.h"
+#include "llvm/IR/DiagnosticInfo.h"
+#include "llvm/IR/DiagnosticPrinter.h"
+#include "llvm/LTO/LTO.h"
+#include "llvm/Support/CachePruning.h"
+#include "llvm/Support/Caching.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Threading.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <memory>
+
+ThinLTOLink::ThinLTOLink(const CodegenOptions& options, unsigned jobs, const std::string& cacheDir,
+                         uint64_t cacheBytes)
+    : options(options), jobs(jobs), cacheDir(cacheDir), cacheBytes(cacheBytes) {
+}
+
+bool ThinLTOLink::isBitcodeFile(const std::string& path) {
+    llvm::file_magic magic;
+    return !llvm::identify_magic(path, magic) && magic == llvm::file_magic::bitcode;
+}
+
+bool ThinLTOLink::link(const std::vector<std::string>& inputs, const std::string& output) {
+    PhaseScope phase("ThinLTOLink", output);
+
+    // same target machine as the compile step (Codegen::hostTargetMachine)
+    llvm::lto::Config config;
+    config.CPU = "generic";
+    config.RelocModel = llvm::Reloc::Model::PIC_;
+    config.DefaultTriple = llvm::sys::getDefaultTargetTriple();
+    config.OptPipeline = options.passPipeline;
+    config.PassPlugins = options.passPlugins;
+    config.DiagHandler = [](const llvm::DiagnosticInfo& info) {
+        llvm::DiagnosticPrinterRawOStream printer(diagnostics());
+        info.print(printer);
+        diagnostics() << "\n";
+    };
+
+    llvm::lto::LTO lto(std::move(config),
+                       llvm::lto::createInProcessThinBackend(llvm::heavyweight_hardware_concurrency(jobs)));
+
+    // the output is a relocatable object linked by cc, other objects may call
+    // any exported function, so every definition stays visible. imported copies
+    // are still inlined, only the original body is kept
+    std::vector<std::unique_ptr<llvm::MemoryBuffer>> buffers;
+    std::map<std::string, std::string> definedIn;
+    for (const auto& input : inputs) {
+        auto buffer = llvm::MemoryBuffer::getFile(input);
+        if (!buffer) {
+            diagnostics() << "Error: could not read '" << input << "': " << buffer.getError().message() << "\n";
+            return false;
+        }
+        auto file = llvm::lto::InputFile::create((*buffer)->getMemBufferRef());
+        if (!file) {
+            diagnostics() << "Error: '" << input << "' is not pilla bitcode: " << llvm::toString(file.takeError())
+                         << "\n";
+            return false;
+        }
+
+        std::vector<llvm::lto::SymbolResolution> resolutions;
+        for (const auto& symbol : (*file)->symbols()) {
+            llvm::lto::SymbolResolution resolution;
+            if (!symbol.isUndefined()) {
+                auto defined = definedIn.insert({symbol.getName().str(), input});
+                if (!defined.second) {
+                    diagnostics() << "Error: '" << symbol.getName() << "' is defined in '" << defined.first->second
+                                 << "' and in '" << input << "'\n";
+                    return false;
+                }
+                resolution.Prevailing = true;
+                resolution.FinalDefinitionInLinkageUnit = true;
+                resolution.VisibleToRegularObj = true;
+            }
+            resolutions.push_back(resolution);
+        }
+        if (auto err = lto.add(std::move(*file), resolutions)) {
+            diagnostics() << "Error: could not add '" << input << "': " << llvm::toString(std::move(err)) << "\n";
+            return false;
+        }
+        buffers.push_back(std::move(*buffer));
+    }
+
+    // one object per task (task 0 is the regular LTO module, empty here). the
+    // backends run in parallel, each writes only its own slot
+    std::vector<llvm::SmallString<0>> objects(lto.getMaxTasks());
+    auto addStream = [&](unsigned task, const llvm::Twine&)
+        -> llvm::Expected<std::unique_ptr<llvm::CachedFileStream>> {
+        return std::make_unique<llvm::CachedFileStream>(std::make_unique<llvm::raw_svector_ostream>(objects[task]));
+    };
+
+    // hits and freshly written entries both arrive through addBuffer
+    llvm::FileCache cache;
+    if (!cacheDir.empty()) {
+        auto addBuffer = [&](unsigned task, const llvm::Twine&, std::unique_ptr<llvm::MemoryBuffer> buffer) {
+            objects[task] = buffer->getBuffer();
+        };
+        auto localCache = llvm::localCache("ThinLTO", "pilla-thinlto", cacheDir, addBuffer);
+        if (!localCache) {
+            diagnostics() << "Warning: could not use the ThinLTO cache '" << cacheDir
+                         << "': " << llvm::toString(localCache.takeError()) << "\n";
+        } else {
+            cache = std::move(*localCache);
+        }
+    }
+
+    if (auto err = lto.run(addStream, cache)) {
+        diagnostics() << "Error: ThinLTO failed: " << llvm::toString(std::move(err)) << "\n";
+        return false;
+    }
+
+    if (cache.isValid()) {
+        // cacheBytes is what the object cache next to it leaves over. prune on
+        // every link (the default waits 20 minutes between scans), 0 would
+        // mean no limit to LLVM, so keep at least one byte
+        llvm::CachePruningPolicy policy;
+        policy.Interval = std::chrono::seconds(0);
+        policy.MaxSizeBytes = std::max<uint64_t>(cacheBytes, 1);
+        llvm::pruneCache(cacheDir, policy);
+    }
+
+    // ld -r wants files
+    std::vector<std::string> paths;
+    auto removeParts = [&] {
+        for (const auto& path : paths) {
+            llvm::sys::fs::remove(path);
+        }
+    };
+    for (const auto& object : objects) {
+        if (object.empty()) continue;
+        llvm::SmallString<128> path;
+        int fd;
+        if (std::error_code EC = llvm::sys::fs::createTemporaryFile("pilla-thinlto", "o", fd, path)) {
+            diagnostics() << "Could not create temporary file: " << EC.message() << "\n";
+            removeParts();
+            return false;
+        }
+        paths.push_back(std::string(path));
+        llvm::raw_fd_ostream os(fd, true);
+        os << object;
+    }
+
+    bool linked = linkRelocatable(paths, output);
+    removeParts();
+    if (!linked) {
+        return false;
+    }
+
+    std::cout << "Object file written to: " << output << " (ThinLTO, " << inputs.size()
+              << (inputs.size() == 1 ? " module)\n" : " modules)\n");
+    return true;
+}
@@ -0,0 +1,156 @@
+#include "driver/WatchMode.h"
+#include "parser/ModuleInterface.h"
+#include "llvm/Support/Path.h"
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+
+namespace {
+    volatile std::sig_atomic_t stopRequested = 0;
+
+    void requestStop(int) {
+        stopRequested = 1;
+    }
+
+    // one save is several events (truncate, write, close, rename), the build
+    // starts once none arrived for this long
+    constexpr int settleMillis = 50;
+}
+
+WatchMode::WatchMode(const DriverOptions& options)
+    : options(options), input(options.inputFiles.front()), build(options.codegen) {
+    watchedFiles.insert(input);
+}
+
+bool WatchMode::rebuild() {
+    auto start = std::chrono::steady_clock::now();
+
+    std::ifstream file(input);
+    if (!file.is_open()) {
+        std::cerr << "Error: Could not open file '" << input << "'\n";
+        return false;
+    }
+    std::stringstream text;
+    text << file.rdbuf();
+    queries.setFileText(input, text.str());
+
+    std::vector<std::string> diagnostics;
+    bool ok = queries.check(input, diagnostics);
+    for (const auto& message : diagnostics) {
+        std::cerr << message << "\n";
+    }
+    ProgramAST& program = queries.programOf(input);
+    // an edited import changes the signatures this file sees
+    for (const auto& import : program.imports) {
+        watchedFiles.insert(resolveImport(input, import));
+    }
+    if (ok) {
+        ok = build.update(program);
+    }
+    if (ok) {
+        ok = options.emitLLVMOnly ? build.printModule(llvm::errs()) : build.writeObject(options.outputFile);
+    }
+    if (ok && !options.emitLLVMOnly) {
+        writeInterface(program, text.str(), input);
+    }
+    if (!ok) {
+        std::cerr << "✗ Build failed, waiting for changes\n";
+        return false;
+    }
+
+    double millis = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    char summary[128];
+    std::snprintf(summary, sizeof(summary), "✓ %u functions rebuilt, %u reused (%.1f ms)", build.getRebuilt(),
+                  build.getReused(), millis);
+    std::cout << summary << std::endl;
+    return true;
+}
+
+int WatchMode::run() {
+    int notify = inotify_init1(IN_CLOEXEC);
+    if (notify < 0) {
+        std::cerr << "Error: could not start watching: " << std::strerror(errno) << "\n";
+        return 1;
+    }
+
+    // a watch per directory, and the names in it that belong to the program.
+    // builds can add files (new imports), old ones stay watched
+    std::map<int, std::set<std::string>> watches;
+    auto addWatches = [&] {
+        for (const auto& path : watchedFiles) {
+            std::string directory = llvm::sys::path::parent_path(path).str();
+            if (directory.empty()) directory = ".";
+            int watch = inotify_add_watch(notify, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+            if (watch < 0) {
+                std::cerr << "Error: could not watch '" << directory << "': " << std::strerror(errno) << "\n";
+                return false;
+            }
+            watches[watch].insert(llvm::sys::path::filename(path).str());
+        }
+        return true;
+    };
+    if (!addWatches()) {
+        close(notify);
+        return 1;
+    }
+
+    // no SA_RESTART, so a signal interrupts poll and the loop can stop
+    struct sigaction action;
+    std::memset(&action, 0, sizeof(action));
+    action.sa_handler = requestStop;
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+
+    std::cout << "Watching " << input << " (Ctrl-C to stop)" << std::endl;
+    rebuild();
+    addWatches();
+
+    alignas(inotify_event) char buffer[4096];
+    int exitCode = 0;
+    while (!stopRequested) {
+        // blocks until a watched file changed, then until the events settle
+        bool changed = false;
+        int timeout = -1;
+        for (;;) {
+            pollfd events = {notify, POLLIN, 0};
+            int ready = poll(&events, 1, timeout);
+            if (ready < 0 && errno == EINTR && !stopRequested) continue;
+            if (ready <= 0) break;
+
+            ssize_t n = read(notify, buffer, sizeof(buffer));
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) break;
+            for (char* p = buffer; p < buffer + n;) {
+                auto* event = reinterpret_cast<inotify_event*>(p);
+                auto watch = watches.find(event->wd);
+                if (event->len && watch != watches.end() && watch->second.count(event->name)) {
+                    changed = true;
+                }
+                p += sizeof(inotify_event) + event->len;
+            }
+            if (changed) timeout = settleMillis;
+        }
+
+        if (stopRequested) break;
+        if (!changed) {
+            std::cerr << "Error: watching failed: " << std::strerror(errno) << "\n";
+            exitCode = 1;
+            break;
+        }
+        rebuild();
+        addWatches();
+    }
+
+    close(notify);
+    std::cout << "Stopped watching " << input << std::endl;
+    return exitCode;
+}
@@ -0,0 +1,76 @@
+#include "jit/JIT.h"
+#include "support/Timing.h"
+#include "llvm/ExecutionEngine/Orc/CompileOnDemandLayer.h"
+#include "llvm/ExecutionEngine/Orc/CompileUtils.h"
+#include "llvm/ExecutionEngine/Orc/ExecutionUtils.h"
+#include "llvm/IR/Module.h"
+#include <cstdint>
+#include <cstdio>
+
+llvm::Expected<std::unique_ptr<JIT>> JIT::create(bool lazy, JITObjectCache* cache) {
+    std::unique_ptr<llvm::orc::LLJIT> jit;
+    if (lazy) {
+        auto lazyJIT = llvm::orc::LLLazyJITBuilder().create();
+        if (!lazyJIT) return lazyJIT.takeError();
+        // one partition per function: only the requested function is compiled,
+        // its callees stay behind stubs until they are called
+        (*lazyJIT)->setPartitionFunction(llvm::orc::CompileOnDemandLayer::compileRequested);
+        jit = std::move(*lazyJIT);
+    } else {
+        llvm::orc::LLJITBuilder builder;
+        if (cache) {
+            // the simple compiler asks the cache first and skips instruction selection on a hit
+            builder.setCompileFunctionCreator([cache](llvm::orc::JITTargetMachineBuilder jtmb)
+                    -> llvm::Expected<std::unique_ptr<llvm::orc::IRCompileLayer::IRCompiler>> {
+                auto tm = jtmb.createTargetMachine();
+                if (!tm) return tm.takeError();
+                return std::make_unique<llvm::orc::TMOwningSimpleCompiler>(std::move(*tm), cache);
+            });
+        }
+        auto created = builder.create();
+        if (!created) return created.takeError();
+        jit = std::move(*created);
+    }
+
+    // resolve libc (printf) and everything else from the host process
+    auto generator = llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(
+        jit->getDataLayout().getGlobalPrefix());
+    if (!generator) return generator.takeError();
+    jit->getMainJITDylib().addGenerator(std::move(*generator));
+
+    return std::unique_ptr<JIT>(new JIT(std::move(jit), lazy));
+}
+
+llvm::Error JIT::addModule(llvm::orc::ThreadSafeModule module) {
+    module.withModuleDo([&](llvm::Module& M) {
+        if (llvm::Function* main = M.getFunction("main")) {
+            mainReturnsVoid = main->getReturnType()->isVoidTy();
+        }
+    });
+    if (lazy) {
+        return static_cast<llvm::orc::LLLazyJIT&>(*jit).addLazyIRModule(std::move(module));
+    }
+    return jit->addIRModule(std::move(module));
+}
+
+llvm::Expected<int> JIT::runMain() {
+    llvm::orc::ExecutorAddr mainAddr;
+    {
+        // the lookup is what actually compiles the module (only main when lazy)
+        PhaseScope phase("JITCompile");
+        auto symbol = jit->lookup("main");
+        if (!symbol) return symbol.takeError();
+        mainAddr = *symbol;
+    }
+
+    int result = 0;
+    if (mainReturnsVoid) {
+        mainAddr.toPtr<void (*)()>()();
+    } else {
+        // pilla int is 64 bit
+        result = (int)mainAddr.toPtr<int64_t (*)()>()();
+    }
+    // the program's printf output shares stdout with the compiler
+    std::fflush(stdout);
+    return result;
+}
@@ -0,0 +1,112 @@
+#include "jit/ObjectCache.h"
+#include "driver/CompileCache.h"
+#include "support/OutputCapture.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/SHA256.h"
+#include "llvm/Support/raw_ostream.h"
+
+namespace {
+    // keys are hex digests, anything else was not prepared by codegen
+    const char* keyPrefix = "pilla-jit-";
+}
+
+JITObjectCache::JITObjectCache(const std::string& dir) : dir(dir) {
+    if (this->dir.empty()) {
+        llvm::SmallString<128> path;
+        if (!llvm::sys::path::cache_directory(path)) {
+            path = llvm::sys::path::get_separator();
+            llvm::sys::path::append(path, "tmp");
+        }
+        llvm::sys::path::append(path, "pilla-jit");
+        this->dir = std::string(path);
+    }
+    if (auto EC = llvm::sys::fs::create_directories(this->dir)) {
+        diagnostics() << "Warning: could not create JIT cache directory '" << this->dir << "': "
+                     << EC.message() << "\n";
+    }
+    buildId = CompileCache::compilerBuildId();
+}
+
+std::string JITObjectCache::computeKey(const llvm::Module& module, llvm::StringRef pipeline) const {
+    std::string ir;
+    llvm::raw_string_ostream os(ir);
+    module.print(os, nullptr);
+    os.flush();
+
+    // the key is taken before the module pipeline so a hit can skip it. that is
+    // safe because the pipeline is deterministic: the unoptimized IR, the
+    // pipeline configuration and the compiler build fix the optimized module
+    llvm::SHA256 hasher;
+    hasher.update(ir);
+    // the same IR still compiles to different code for another cpu or pipeline
+    hasher.update(llvm::sys::getProcessTriple());
+    hasher.update(llvm::sys::getHostCPUName());
+    hasher.update(pipeline);
+    // a new compiler or LLVM may run other passes under the same pipeline name
+    hasher.update(buildId);
+    auto digest = hasher.final();
+    return keyPrefix + llvm::toHex(llvm::ArrayRef<uint8_t>(digest), true);
+}
+
+std::string JITObjectCache::pathFor(llvm::StringRef key) const {
+    llvm::SmallString<128> path(dir);
+    llvm::sys::path::append(path, key + ".o");
+    return std::string(path);
+}
+
+bool JITObjectCache::load(llvm::StringRef key) {
+    // no null terminator needed, so large objects are mmap'ed
+    auto buffer = llvm::MemoryBuffer::getFile(pathFor(key), false, false);
+    if (!buffer) return false;
+    std::lock_guard<std::mutex> lock(loadedMutex);
+    loaded[key] = std::move(*buffer);
+    return true;
+}
+
+void JITObjectCache::notifyObjectCompiled(const llvm::Module* module, llvm::MemoryBufferRef object) {
+    llvm::StringRef key = module->getModuleIdentifier();
+    if (!key.starts_with(keyPrefix)) return;
+
+    // write next to the final name and rename, concurrent runs never see half an object
+    llvm::SmallString<128> tmpPath;
+    int fd;
+    if (llvm::sys::fs::createUniqueFile(pathFor(key) + ".%%%%%%.tmp", fd, tmpPath)) {
+        return;
+    }
+    {
+        llvm::raw_fd_ostream os(fd, true);
+        os << object.getBuffer();
+    }
+    if (llvm::sys::fs::rename(tmpPath, pathFor(key))) {
+        llvm::sys::fs::remove(tmpPath);
+    }
+}
+
+std::unique_ptr<llvm::MemoryBuffer> JITObjectCache::getObject(const llvm::Module* module) {
+    llvm::StringRef key = module->getModuleIdentifier();
+    if (!key.starts_with(keyPrefix)) return nullptr;
+
+    {
+        std::lock_guard<std::mutex> lock(loadedMutex);
+        auto it = loaded.find(key);
+        if (it != loaded.end()) {
+            std::unique_ptr<llvm::MemoryBuffer> object = std::move(it->second);
+            loaded.erase(it);
+            hits++;
+            return object;
+        }
+    }
+
+    // the module went through the pipeline, another run may have stored it since
+    auto buffer = llvm::MemoryBuffer::getFile(pathFor(key), false, false);
+    if (!buffer) {
+        misses++;
+        return nullptr;
+    }
+    hits++;
+    return std::move(*buffer);
+}
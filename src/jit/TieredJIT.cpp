@@ -0,0 +1,251 @@
+#include "jit/TieredJIT.h"
+#include "passes/pass3.h"
+#include "support/Timing.h"
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/ExecutionEngine/Orc/ExecutionUtils.h"
+#include "llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/ProfileData/InstrProf.h"
+#include "llvm/ProfileData/ProfileCommon.h"
+#include "llvm/Support/SmallVectorMemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetMachine.h"
+#include <cstdio>
+
+namespace {
+    // tier 1 code calls a plain function, it finds the jit through this
+    TieredJIT* activeJIT = nullptr;
+
+    void tierUpHook(int64_t id) {
+        if (activeJIT) activeJIT->requestTierUp((unsigned)id);
+    }
+}
+
+llvm::Expected<std::unique_ptr<TieredJIT>> TieredJIT::create(uint64_t threshold) {
+    auto jtmb = llvm::orc::JITTargetMachineBuilder::detectHost();
+    if (!jtmb) return jtmb.takeError();
+    // tier 1 is about compile speed, tier 2 brings its own target machine
+    jtmb->setCodeGenOptLevel(llvm::CodeGenOptLevel::None);
+
+    auto jit = llvm::orc::LLJITBuilder().setJITTargetMachineBuilder(std::move(*jtmb)).create();
+    if (!jit) return jit.takeError();
+
+    auto generator = llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(
+        (*jit)->getDataLayout().getGlobalPrefix());
+    if (!generator) return generator.takeError();
+    (*jit)->getMainJITDylib().addGenerator(std::move(*generator));
+
+    // the hook the instrumented code calls when a function gets hot
+    llvm::orc::SymbolMap hook;
+    hook[(*jit)->mangleAndIntern("__pilla_tier_up")] = {
+        llvm::orc::ExecutorAddr::fromPtr(&tierUpHook),
+        llvm::JITSymbolFlags::Exported | llvm::JITSymbolFlags::Callable};
+    if (auto err = (*jit)->getMainJITDylib().define(llvm::orc::absoluteSymbols(std::move(hook)))) {
+        return std::move(err);
+    }
+
+    return std::unique_ptr<TieredJIT>(new TieredJIT(std::move(*jit), threshold));
+}
+
+TieredJIT::TieredJIT(std::unique_ptr<llvm::orc::LLJIT> jit, uint64_t threshold)
+    : jit(std::move(jit)), threshold(threshold) {
+    activeJIT = this;
+    worker = std::thread([this] { compileLoop(); });
+}
+
+TieredJIT::~TieredJIT() {
+    stopWorker();
+    if (activeJIT == this) activeJIT = nullptr;
+}
+
+void TieredJIT::stopWorker() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        queue.clear();
+    }
+    wakeUp.notify_all();
+    if (worker.joinable()) worker.join();
+}
+
+llvm::Error TieredJIT::addModule(llvm::orc::ThreadSafeModule module) {
+    std::vector<std::string> names;
+    module.withModuleDo([&](llvm::Module& M) {
+        if (llvm::Function* main = M.getFunction("main")) {
+            mainReturnsVoid = main->getReturnType()->isVoidTy();
+        }
+
+        // keep a clean copy for tier 2 before instrumenting
+        llvm::raw_svector_ostream os(bitcode);
+        llvm::WriteBitcodeToFile(M, os);
+
+        llvm::LoopAnalysisManager lam;
+        llvm::FunctionAnalysisManager fam;
+        llvm::CGSCCAnalysisManager cgam;
+        llvm::ModuleAnalysisManager mam;
+        llvm::PassBuilder pb;
+        pb.registerModuleAnalyses(mam);
+        pb.registerCGSCCAnalyses(cgam);
+        pb.registerFunctionAnalyses(fam);
+        pb.registerLoopAnalyses(lam);
+        pb.crossRegisterProxies(lam, fam, cgam, mam);
+
+        llvm::ModulePassManager mpm;
+        mpm.addPass(llvm::TierInstrumentPass(threshold, &names));
+        mpm.run(M, mam);
+    });
+
+    if (auto err = jit->addIRModule(std::move(module))) return err;
+
+    // looking up the slots compiles tier 1
+    PhaseScope phase("JITCompile");
+    for (const auto& name : names) {
+        TierFunction function;
+        function.name = name;
+        auto slot = jit->lookup("__pilla_tier." + name);
+        if (!slot) return slot.takeError();
+        function.slot = slot->toPtr<void**>();
+        auto counter = jit->lookup("__pilla_count." + name);
+        if (!counter) return counter.takeError();
+        function.counter = counter->toPtr<uint64_t*>();
+        auto calls = jit->lookup("__pilla_calls." + name);
+        if (!calls) return calls.takeError();
+        function.calls = calls->toPtr<uint64_t*>();
+        functions.push_back(function);
+    }
+    return llvm::Error::success();
+}
+
+void TieredJIT::requestTierUp(unsigned id) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stopping || id >= functions.size()) return;
+        queue.push_back(id);
+    }
+    wakeUp.notify_one();
+}
+
+void TieredJIT::compileLoop() {
+    beginThreadTimeTrace();
+    for (;;) {
+        unsigned id;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wakeUp.wait(lock, [&] { return stopping || !queue.empty(); });
+            if (stopping) break;
+            id = queue.front();
+            queue.pop_front();
+        }
+        if (auto err = compileTier2(id)) {
+            llvm::errs() << "Warning: tier 2 compile of '" << functions[id].name << "' failed: "
+                         << llvm::toString(std::move(err)) << "\n";
+        }
+    }
+    endThreadTimeTrace();
+}
+
+llvm::Error TieredJIT::compileTier2(unsigned id) {
+    TierFunction& target = functions[id];
+    PhaseScope phase("TierUpCompile", target.name);
+
+    auto context = std::make_unique<llvm::LLVMContext>();
+    auto module = llvm::parseBitcodeFile(
+        llvm::MemoryBufferRef(llvm::StringRef(bitcode.data(), bitcode.size()), "tier2"), *context);
+    if (!module) return module.takeError();
+
+    // the hot function is the only entry point, everything else in this copy
+    // is private to it, so it can be inlined or dropped. the tier 1 call
+    // counts become entry counts, and with a profile summary over them the
+    // inliner and block placement can tell hot functions from cold ones
+    llvm::InstrProfSummaryBuilder summary(llvm::ProfileSummaryBuilder::DefaultCutoffs);
+    for (llvm::Function& F : **module) {
+        if (F.isDeclaration()) continue;
+        for (const auto& function : functions) {
+            if (function.name == F.getName()) {
+                uint64_t calls = __atomic_load_n(function.calls, __ATOMIC_RELAXED);
+                F.setEntryCount(calls);
+                // a record's first counter is its entry count
+                summary.addRecord(llvm::InstrProfRecord({calls}));
+                break;
+            }
+        }
+        F.setLinkage(llvm::GlobalValue::InternalLinkage);
+    }
+    (*module)->setProfileSummary(summary.getSummary()->getMD(*context), llvm::ProfileSummary::PSK_Instr);
+    llvm::Function* entry = (*module)->getFunction(target.name);
+    std::string entryName = target.name + ".tier2";
+    entry->setName(entryName);
+    entry->setLinkage(llvm::GlobalValue::ExternalLinkage);
+
+    auto jtmb = llvm::orc::JITTargetMachineBuilder::detectHost();
+    if (!jtmb) return jtmb.takeError();
+    jtmb->setCodeGenOptLevel(llvm::CodeGenOptLevel::Aggressive);
+    auto tm = jtmb->createTargetMachine();
+    if (!tm) return tm.takeError();
+    (*module)->setDataLayout((*tm)->createDataLayout());
+    (*module)->setTargetTriple((*tm)->getTargetTriple());
+
+    {
+        llvm::LoopAnalysisManager lam;
+        llvm::FunctionAnalysisManager fam;
+        llvm::CGSCCAnalysisManager cgam;
+        llvm::ModuleAnalysisManager mam;
+        llvm::PassBuilder pb(tm->get());
+        pb.registerModuleAnalyses(mam);
+        pb.registerCGSCCAnalyses(cgam);
+        pb.registerFunctionAnalyses(fam);
+        pb.registerLoopAnalyses(lam);
+        pb.crossRegisterProxies(lam, fam, cgam, mam);
+        llvm::ModulePassManager mpm = pb.buildPerModuleDefaultPipeline(llvm::OptimizationLevel::O3);
+        mpm.run(**module, mam);
+    }
+
+    llvm::SmallVector<char, 0> object;
+    {
+        llvm::raw_svector_ostream os(object);
+        llvm::legacy::PassManager pm;
+        if ((*tm)->addPassesToEmitFile(pm, os, nullptr, llvm::CodeGenFileType::ObjectFile)) {
+            return llvm::make_error<llvm::StringError>("target can't emit an object file",
+                                                       llvm::inconvertibleErrorCode());
+        }
+        pm.run(**module);
+    }
+
+    if (auto err = jit->addObjectFile(
+            std::make_unique<llvm::SmallVectorMemoryBuffer>(std::move(object), entryName, false))) {
+        return err;
+    }
+    auto address = jit->lookup(entryName);
+    if (!address) return address.takeError();
+
+    // the next call through the slot runs tier 2
+    __atomic_store_n(target.slot, address->toPtr<void*>(), __ATOMIC_RELEASE);
+    target.optimized = true;
+    return llvm::Error::success();
+}
+
+llvm::Expected<int> TieredJIT::runMain() {
+    auto symbol = jit->lookup("main");
+    if (!symbol) return symbol.takeError();
+
+    int result = 0;
+    if (mainReturnsVoid) {
+        symbol->toPtr<void (*)()>()();
+    } else {
+        result = (int)symbol->toPtr<int64_t (*)()>()();
+    }
+    std::fflush(stdout);
+    stopWorker();
+
+    for (const auto& function : functions) {
+        if (function.optimized) {
+            llvm::errs() << "tier 2: " << function.name << " ("
+                         << __atomic_load_n(function.calls, __ATOMIC_RELAXED) << " calls, "
+                         << __atomic_load_n(function.counter, __ATOMIC_RELAXED) << " with back edges)\n";
+        }
+    }
+    return result;
+}
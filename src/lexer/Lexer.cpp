@@ -1,4 +1,5 @@
 #include "lexer/Lexer.h"
+#include "support/Timing.h"
 #include <cctype> // this for some functions like isdigit, isalpha
 
 // constructor
@@ -6,6 +7,7 @@ Lexer::Lexer(const std::string& source)
     : sourcecode(source), currentPos(0), line(1), column(1) {}
 
 std::vector<Token> Lexer::scanTokens() {
+    PhaseScope phase("Lexer");
     std::vector<Token> tokens;
     Token token = scanToken();
     while (token.type != Tokentype::E_O_F) {
@@ -259,6 +261,10 @@ Token Lexer::identifier() {
         return makeToken(Tokentype::KW_WHILE, idLexeme);
     } else if (idLexeme == "for") {
         return makeToken(Tokentype::KW_FOR, idLexeme);
+    } else if (idLexeme == "export") {
+        return makeToken(Tokentype::KW_EXPORT, idLexeme);
+    } else if (idLexeme == "import") {
+        return makeToken(Tokentype::KW_IMPORT, idLexeme);
     } else {
         return makeToken(Tokentype::IDENTIFIER, idLexeme);
     }
@@ -41,6 +41,8 @@ namespace {
         {Tokentype::KW_ELSE, "KW_ELSE"},
         {Tokentype::KW_WHILE, "KW_WHILE"},
         {Tokentype::KW_FOR, "KW_FOR"},
+        {Tokentype::KW_EXPORT, "KW_EXPORT"},
+        {Tokentype::KW_IMPORT, "KW_IMPORT"},
         {Tokentype::UNKNOWN, "UNKNOWN"},
         {Tokentype::E_O_F, "EOF"}
     };
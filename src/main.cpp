@@ -1,48 +1,283 @@
 #include "lexer/Lexer.h"
 #include "parser/Parser.h"
 #include "parser/ASTPrinter.h"
+#include "parser/ModuleInterface.h"
 #include "sema/Sema.h"
 #include "codegen/Codegen.h"
+#include "driver/BatchCompiler.h"
+#include "driver/CompileCache.h"
+#include "driver/CompileServer.h"
+#include "driver/IncrementalBuild.h"
+#include "driver/ThinLTOLink.h"
+#include "driver/WatchMode.h"
+#include "driver/DriverOptions.h"
+#include "query/QueryEngine.h"
+#include "jit/JIT.h"
+#include "jit/TieredJIT.h"
+#include "vm/BytecodeCompiler.h"
+#include "vm/VM.h"
+#include "support/Timing.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/StringSaver.h"
+#include <algorithm>
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <string>
 #include <vector>
 
+// prints/writes whatever instrumentation was requested
+static void finishReports(const std::string& timeTraceFile) {
+    printTimeReport();
+    printMemReport();
+    if (!timeTraceFile.empty()) {
+        writeTimeTrace(timeTraceFile);
+    }
+}
+
+// --interpret: bytecode + VM, LLVM is not involved at all
+static bool interpret(ProgramAST& ast, bool dumpBytecode, int& exitCode) {
+    BytecodeCompiler compiler;
+    std::unique_ptr<BytecodeProgram> program = compiler.compile(ast);
+    if (!program) {
+        std::cerr << "✗ Bytecode generation failed!\n";
+        return false;
+    }
+    if (dumpBytecode) {
+        program->dump(std::cerr);
+    }
+
+    std::cout << "\n--- Interpreting ---\n" << std::flush;
+    VM vm;
+    return vm.run(*program, exitCode);
+}
+
 int main(int argc, char *argv[])
 {
-    // Parse command-line arguments
-    std::string inputFile;
-    std::string outputFile;
-    bool emitAssembly = false;
-    bool emitLLVMOnly = false;
+    // @file arguments are replaced by the arguments listed in the file
+    llvm::SmallVector<const char*, 64> args(argv, argv + argc);
+    llvm::BumpPtrAllocator allocator;
+    llvm::StringSaver saver(allocator);
+    if (!llvm::cl::ExpandResponseFiles(saver, llvm::cl::TokenizeGNUCommandLine, args)) {
+        std::cerr << "Error: could not read response file\n";
+        return 1;
+    }
+
+    DriverOptions options;
     
-    if (argc < 2) {
-        std::cerr << "Usage: " << argv[0] << " <source-file> [options]\n";
+    if (args.size() < 2) {
+        std::cerr << "Usage: " << argv[0] << " <source-file>... [options]\n";
+        std::cerr << "Several source files (or @<file> listing them) are compiled in parallel, one object each\n";
+        std::cerr << "Bitcode files (from -flto=thin) are linked with ThinLTO into one object: " << argv[0]
+                  << " a.bc b.bc -o program.o\n";
         std::cerr << "Options:\n";
         std::cerr << "  -o <file>     Output file (default: output.o or output.s)\n";
         std::cerr << "  -S            Emit assembly instead of object file\n";
         std::cerr << "  -emit-llvm    Only emit LLVM IR (no object/assembly)\n";
+        std::cerr << "  --run         Run main in process with the JIT instead of writing a file\n";
+        std::cerr << "  --lazy        Like --run, but compile each function on its first call\n";
+        std::cerr << "  --jit-cache[=<dir>]  With --run, reuse machine code of unchanged programs (default: ~/.cache/pilla-jit)\n";
+        std::cerr << "  --tiered      Run main unoptimized first, recompile hot functions at O3 in the background\n";
+        std::cerr << "  --tier-threshold=<n>  Calls + loop iterations before a function is recompiled (default: 1000)\n";
+        std::cerr << "  --interpret   Run main in the bytecode interpreter (no LLVM, fastest startup)\n";
+        std::cerr << "  --dump-bytecode  With --interpret, print the bytecode to stderr\n";
+        std::cerr << "  -ftime-report Print time spent in each phase and pass\n";
+        std::cerr << "  -ftime-trace[=<file>]  Write a Chrome trace (default: <output>.json)\n";
+        std::cerr << "  -ftime-trace-granularity=<us>  Minimum event length in the trace (default: 500)\n";
+        std::cerr << "  --mem-report  Print allocations and peak RSS per phase\n";
+        std::cerr << "  --ir-stats=<file>  Write per function instruction statistics after each pipeline stage\n";
+        std::cerr << "  -fwhole-module  Emit the whole module before optimizing it over the call graph\n";
+        std::cerr << "  -flto=thin    Write bitcode with a module summary (name.bc), inlining across modules happens when the .bc files are linked\n";
+        std::cerr << "  -j<n>         Split the module and run the backend on n threads (object files only)\n";
+        std::cerr << "  -fparallel-codegen[=<n>]  Emit and optimize functions on n threads (default: all cores)\n";
+        std::cerr << "  -passes=<pipeline>  Run this pass pipeline instead of the built in one\n";
+        std::cerr << "  -load-pass-plugin=<.so>  Load an LLVM pass plugin (may be repeated)\n";
+        std::cerr << "  --jobs=<n>    Files compiled at the same time with several inputs (default: all cores)\n";
+        std::cerr << "  --cache[=<dir>]     Reuse the output of identical compiles (default: ~/.cache/pilla)\n";
+        std::cerr << "  --cache-size=<MB>   Size limit of the cache, least recently used outputs go first (default: 1024)\n";
+        std::cerr << "  --cache-stats       Print cache hits, misses and size\n";
+        std::cerr << "  --incremental[=<dir>]  Keep an object per function, rebuild only changed functions (no cross function inlining)\n";
+        std::cerr << "  --watch       Rebuild the output on every save, only the functions that changed\n";
+        std::cerr << "  --check       Only lex, parse and analyze, print the diagnostics\n";
+        std::cerr << "  --query-stats With --check, print which front end queries ran and which were reused\n";
+        std::cerr << "  --serve <socket>    Run as compile server on a unix socket\n";
+        std::cerr << "  --connect <socket>  Let the compile server at <socket> do this compile (in process if there is none)\n";
         return 1;
     }
     
-    inputFile = argv[1];
-    
-    // Parse options
-    for (int i = 2; i < argc; i++) {
-        std::string arg = argv[i];
-        if (arg == "-S") {
-            emitAssembly = true;
-        } else if (arg == "-emit-llvm") {
-            emitLLVMOnly = true;
-        } else if (arg == "-o" && i + 1 < argc) {
-            outputFile = argv[++i];
+    if (!parseDriverOptions(std::vector<std::string>(args.begin() + 1, args.end()), options)) {
+        return 1;
+    }
+
+    // the -flto=thin link step. it keeps nothing in memory between runs (the
+    // backend cache is on disk), so it always runs in process
+    bool thinLink = !options.inputFiles.empty() &&
+                    std::all_of(options.inputFiles.begin(), options.inputFiles.end(), ThinLTOLink::isBitcodeFile);
+
+    // compile server, and clients handing their compile to it
+    if (!options.serveSocket.empty()) {
+        Codegen::initializeTargets();
+        CompileServer server(options.serveSocket, options.jobs);
+        return server.run();
+    }
+    if (!options.connectSocket.empty() && !thinLink) {
+        // everything but --connect itself goes to the server
+        std::vector<std::string> forwarded;
+        for (size_t i = 1; i < args.size(); i++) {
+            if (std::string(args[i]) == "--connect") {
+                i++;
+                continue;
+            }
+            forwarded.push_back(args[i]);
+        }
+        int exitCode = 0;
+        if (forwardToServer(options.connectSocket, forwarded, exitCode)) {
+            return exitCode;
         }
+        std::cerr << "Warning: no compile server at '" << options.connectSocket << "', compiling in process\n";
+    }
+
+    if (options.inputFiles.empty()) {
+        std::cerr << "Error: no input file\n";
+        return 1;
+    }
+    std::string inputFile = options.inputFiles.front();
+    bool batch = options.inputFiles.size() > 1 && !thinLink;
+    if (batch && !options.outputFile.empty()) {
+        std::cerr << "Error: -o cannot be used with several input files\n";
+        return 1;
+    }
+    if (batch && (options.runJIT || options.tiered || options.interpretMode || options.emitLLVMOnly)) {
+        std::cerr << "Error: several input files can only be compiled to object or assembly files\n";
+        return 1;
+    }
+    if (thinLink && (options.emitAssembly || options.emitLLVMOnly || options.runJIT || options.tiered ||
+                     options.interpretMode || options.incremental || options.watch || options.checkOnly)) {
+        std::cerr << "Error: bitcode files can only be linked into an object\n";
+        return 1;
+    }
+    if (!thinLink && options.codegen.thinLTO &&
+        (options.emitAssembly || options.runJIT || options.tiered || options.interpretMode ||
+         options.incremental || options.watch)) {
+        std::cerr << "Error: -flto=thin only applies to files compiled to objects\n";
+        return 1;
+    }
+    if (options.incremental && (batch || options.emitAssembly || options.runJIT || options.tiered ||
+                                options.interpretMode)) {
+        std::cerr << "Warning: --incremental only applies to a single file compiled to an object or -emit-llvm\n";
+        options.incremental = false;
+    }
+    if (options.incremental && options.codegen.wholeModule) {
+        std::cerr << "Warning: -fwhole-module is ignored with --incremental, functions are optimized one at a time\n";
+    }
+    if (options.watch && (batch || options.emitAssembly || options.runJIT || options.tiered ||
+                          options.interpretMode || options.checkOnly)) {
+        std::cerr << "Error: --watch only applies to a single file compiled to an object or -emit-llvm\n";
+        return 1;
     }
     
     // Set default output file if not specified
-    if (outputFile.empty() && !emitLLVMOnly) {
-        outputFile = emitAssembly ? "output.s" : "output.o";
+    if (options.outputFile.empty() && !options.emitLLVMOnly && !options.runJIT && !options.interpretMode && !options.tiered && !batch) {
+        options.outputFile = defaultOutputFile(options, thinLink);
+    }
+
+    // -ftime-trace without a file name writes next to the output
+    if (options.timeTraceFile == "-") {
+        options.timeTraceFile = (options.outputFile.empty() ? std::string("output") : options.outputFile) + ".json";
+    }
+    if (options.timeReport) {
+        enableTimeReport();
+    }
+    if (options.memReport) {
+        enableMemReport();
+    }
+    if (!options.timeTraceFile.empty()) {
+        enableTimeTrace(options.timeTraceGranularity);
+    }
+
+    // -flto=thin link: imports across modules, then a backend per module on
+    // --jobs threads. with --cache unchanged modules are not compiled again
+    if (thinLink) {
+        Codegen::initializeTargets();
+        std::string cacheDir;
+        uint64_t cacheBytes = 0;
+        if (options.compileCache) {
+            CompileCache compileCache(options.compileCacheDir, options.compileCacheSize);
+            cacheDir = compileCache.getThinLTODir();
+            cacheBytes = compileCache.thinLTOBudget();
+        }
+        ThinLTOLink linker(options.codegen, options.jobs, cacheDir, cacheBytes);
+        bool ok = linker.link(options.inputFiles, options.outputFile);
+        finishReports(options.timeTraceFile);
+        return ok ? 0 : 1;
+    }
+
+    // --check: diagnostics only. a compile server keeps the query results
+    // between requests, in process every query runs once
+    if (options.checkOnly) {
+        QueryEngine queries;
+        bool ok = true;
+        for (const auto& input : options.inputFiles) {
+            std::ifstream file(input);
+            if (!file.is_open()) {
+                std::cerr << "Error: Could not open file '" << input << "'\n";
+                ok = false;
+                continue;
+            }
+            std::stringstream text;
+            text << file.rdbuf();
+            queries.setFileText(input, text.str());
+            std::vector<std::string> diagnostics;
+            ok = queries.check(input, diagnostics) && ok;
+            for (const auto& message : diagnostics) {
+                std::cerr << message << "\n";
+            }
+        }
+        if (options.queryStats) {
+            queries.printStats(llvm::errs());
+        }
+        finishReports(options.timeTraceFile);
+        return ok ? 0 : 1;
+    }
+
+    // --watch: every save rebuilds the output, front end results and the
+    // code of unchanged functions are kept in memory
+    if (options.watch) {
+        Codegen::initializeTargets();
+        WatchMode watch(options);
+        int exitCode = watch.run();
+        finishReports(options.timeTraceFile);
+        return exitCode;
+    }
+
+    // the lazy JIT compiles per function partitions, those are not cached
+    std::unique_ptr<JITObjectCache> objectCache;
+    if (options.jitCache && (options.lazyJIT || options.tiered)) {
+        std::cerr << "Warning: --jit-cache is ignored with --lazy and --tiered\n";
+    } else if (options.jitCache && options.runJIT) {
+        objectCache = std::make_unique<JITObjectCache>(options.jitCacheDir);
+        options.codegen.objectCache = objectCache.get();
+    }
+
+    // --cache only applies to object and assembly output
+    std::unique_ptr<CompileCache> compileCache;
+    bool writesFile = !options.emitLLVMOnly && !options.runJIT && !options.tiered && !options.interpretMode;
+    if (options.compileCache && writesFile) {
+        compileCache = std::make_unique<CompileCache>(options.compileCacheDir, options.compileCacheSize);
+    }
+    auto printCacheStats = [&] {
+        if (compileCache && options.cacheStats) {
+            compileCache->printStats(llvm::errs());
+        }
+    };
+
+    if (batch) {
+        Codegen::initializeTargets();
+        BatchCompiler compiler(options.codegen, options.emitAssembly, options.jobs, compileCache.get());
+        int exitCode = compiler.run(options.inputFiles);
+        printCacheStats();
+        finishReports(options.timeTraceFile);
+        return exitCode;
     }
     
     std::ifstream file(inputFile);
@@ -58,6 +293,21 @@ int main(int argc, char *argv[])
     buffer << file.rdbuf();
     std::string code = buffer.str();
 
+    // same source, flags, compiler and target: the output is copied from the cache
+    std::string cacheKey;
+    if (compileCache) {
+        Codegen::initializeTargets();
+        cacheKey = compileCache->computeKey(code, options.codegen, options.emitAssembly,
+                                            importedSignatures(code, inputFile));
+        if (compileCache->fetch(cacheKey, options.outputFile)) {
+            std::cout << "Cache hit: " << options.outputFile << "\n";
+            refreshInterface(code, inputFile);
+            printCacheStats();
+            finishReports(options.timeTraceFile);
+            return 0;
+        }
+    }
+
     std::cout << "--- Lexing Source Code ---" << std::endl;
     std::cout << code << std::endl;
     std::cout << "--- Generated Tokens ---" << std::endl;
@@ -83,6 +333,17 @@ int main(int argc, char *argv[])
 
     std::cout << "\n ✓ AST constructed successfully!" << std::endl;
 
+    // imported functions are only declared, their code comes from the other
+    // module's object at link time
+    if (!resolveImports(*ast, inputFile)) {
+        std::cerr << "✗ Imports could not be resolved!\n";
+        return 1;
+    }
+    if (!ast->imports.empty() && (options.runJIT || options.tiered || options.interpretMode)) {
+        std::cerr << "Error: a program with imports has to be compiled to objects and linked\n";
+        return 1;
+    }
+
     // ===== AST VISUALIZATION =====
     ASTPrinter printer;
     printer.print(*ast);
@@ -96,25 +357,122 @@ int main(int argc, char *argv[])
     }
     std::cout << "✓ Semantic analysis passed!\n";
 
+    if (options.interpretMode) {
+        int exitCode = 0;
+        bool ok = interpret(*ast, options.dumpBytecode, exitCode);
+        finishReports(options.timeTraceFile);
+        return ok ? exitCode : 1;
+    }
+
+    if (options.incremental) {
+        Codegen::initializeTargets();
+        IncrementalBuild build(options.incrementalDir, options.codegen);
+        bool ok = build.update(*ast);
+        if (ok) {
+            ok = options.emitLLVMOnly ? build.printModule(llvm::errs()) : build.writeObject(options.outputFile);
+        }
+        if (ok && !options.emitLLVMOnly) {
+            writeInterface(*ast, code, inputFile);
+        }
+        std::cout << "Incremental build: " << build.getRebuilt() << " functions rebuilt, "
+                  << build.getReused() << " reused\n";
+        finishReports(options.timeTraceFile);
+        return ok ? 0 : 1;
+    }
+
     // ===== CODE GENERATION =====
     std::cout << "\n--- Generating LLVM IR ---\n";
-    Codegen codegen;
+    // tiered: tier 1 runs the module as emitted, only hot functions get optimized
+    if (options.tiered) {
+        options.codegen.optimize = false;
+    }
+    Codegen codegen(options.codegen);
+    if (!codegen.pipelineValid()) {
+        std::cerr << "✗ Invalid pass pipeline!\n";
+        return 1;
+    }
     
     // Initialize LLVM targets
     codegen.initializeTargets();
     
     // Generate LLVM IR
     codegen.generate(*ast);
+    if (!codegen.generated()) {
+        std::cerr << "✗ Code generation failed!\n";
+        return 1;
+    }
     
+    // --run / --tiered: no object file, the JIT compiles the module in memory and calls main
+    int exitCode = 0;
+    if (options.tiered) {
+        std::cout << "\n--- Running (tiered) ---\n" << std::flush;
+        auto jit = TieredJIT::create(options.tierThreshold);
+        if (!jit) {
+            std::cerr << "✗ Could not create the JIT: " << llvm::toString(jit.takeError()) << "\n";
+            return 1;
+        }
+        if (auto err = (*jit)->addModule(codegen.takeModule())) {
+            std::cerr << "✗ JIT failed: " << llvm::toString(std::move(err)) << "\n";
+            return 1;
+        }
+        auto result = (*jit)->runMain();
+        if (!result) {
+            std::cerr << "✗ JIT failed: " << llvm::toString(result.takeError()) << "\n";
+            return 1;
+        }
+        exitCode = *result;
+    }
+    else if (options.runJIT) {
+        std::cout << "\n--- Running ---\n" << std::flush;
+        auto jit = JIT::create(options.lazyJIT, objectCache.get());
+        if (!jit) {
+            std::cerr << "✗ Could not create the JIT: " << llvm::toString(jit.takeError()) << "\n";
+            return 1;
+        }
+        if (auto err = (*jit)->addModule(codegen.takeModule())) {
+            std::cerr << "✗ JIT failed: " << llvm::toString(std::move(err)) << "\n";
+            return 1;
+        }
+        auto result = (*jit)->runMain();
+        if (!result) {
+            std::cerr << "✗ JIT failed: " << llvm::toString(result.takeError()) << "\n";
+            return 1;
+        }
+        exitCode = *result;
+        if (objectCache) {
+            std::cout << "JIT cache " << (objectCache->getHits() ? "hit" : "miss") << "\n";
+        }
+    }
     // Emit object code or assembly based on flags
-    if (!emitLLVMOnly) {
+    else if (!options.emitLLVMOnly) {
         std::cout << "\n--- Generating Machine Code ---\n";
-        if (emitAssembly) {
-            codegen.emitAssembly(outputFile);
-        } else {
-            codegen.emitObjectCode(outputFile);
+        if (options.emitAssembly) {
+            if (options.codegen.backendThreads > 1) {
+                std::cerr << "Warning: -j is ignored with -S\n";
+            }
+            if (!codegen.emitAssembly(options.outputFile)) {
+                exitCode = 1;
+            }
+        } else if (options.codegen.thinLTO) {
+            if (options.codegen.backendThreads > 1) {
+                std::cerr << "Warning: -j is ignored with -flto=thin, the backends run in the link step (--jobs)\n";
+            }
+            if (!codegen.emitThinLTOBitcode(options.outputFile)) {
+                exitCode = 1;
+            }
+        } else if (!codegen.emitObjectCode(options.outputFile)) {
+            exitCode = 1;
+        }
+        if (exitCode == 0) {
+            writeInterface(*ast, code, inputFile);
+        }
+        if (compileCache && exitCode == 0) {
+            compileCache->store(cacheKey, options.outputFile);
         }
     }
+    printCacheStats();
+
+    finishReports(options.timeTraceFile);
 
-    return 0;
+    return exitCode;
 }
\ No newline at end of file
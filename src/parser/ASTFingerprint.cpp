@@ -0,0 +1,157 @@
+#include "parser/ASTFingerprint.h"
+#include <cstdio>
+
+std::string ASTFingerprint::of(FunctionAST& function) {
+    text.clear();
+    calledFunctions.clear();
+    function.accept(*this);
+    return text;
+}
+
+void ASTFingerprint::tag(char t) {
+    text += t;
+}
+
+void ASTFingerprint::add(const std::string& value) {
+    text += std::to_string(value.size());
+    text += ':';
+    text += value;
+}
+
+void ASTFingerprint::add(long value) {
+    text += std::to_string(value);
+    text += ';';
+}
+
+void ASTFingerprint::statements(std::vector<std::unique_ptr<StmtAST>>& body) {
+    add((long)body.size());
+    for (auto& stmt : body) {
+        stmt->accept(*this);
+    }
+}
+
+long ASTFingerprint::visit(ProgramAST& node) {
+    tag('P');
+    for (auto& func : node.functions) {
+        func->accept(*this);
+    }
+    return 0;
+}
+
+long ASTFingerprint::visit(FunctionAST& node) {
+    tag('F');
+    add(node.returnType);
+    add(node.name);
+    add((long)node.exported);
+    add((long)node.parameters.size());
+    for (const auto& param : node.parameters) {
+        add(param.first);
+        add(param.second);
+    }
+    statements(node.body);
+    return 0;
+}
+
+long ASTFingerprint::visit(VariableDeclAST& node) {
+    tag('D');
+    add(node.type);
+    add(node.name);
+    add((long)(node.initializer != nullptr));
+    if (node.initializer) node.initializer->accept(*this);
+    return 0;
+}
+
+long ASTFingerprint::visit(ReturnStmtAST& node) {
+    tag('R');
+    add((long)(node.expression != nullptr));
+    if (node.expression) node.expression->accept(*this);
+    return 0;
+}
+
+long ASTFingerprint::visit(PrintStmtAST& node) {
+    tag('E');
+    node.expression->accept(*this);
+    return 0;
+}
+
+long ASTFingerprint::visit(IfStmtAST& node) {
+    tag('I');
+    node.condition->accept(*this);
+    statements(node.thenBranch);
+    statements(node.elseBranch);
+    return 0;
+}
+
+long ASTFingerprint::visit(WhileStmtAST& node) {
+    tag('W');
+    node.condition->accept(*this);
+    statements(node.body);
+    return 0;
+}
+
+long ASTFingerprint::visit(ForStmtAST& node) {
+    tag('L');
+    // missing parts are marked, for (;;) is not for (x;;)
+    add((long)(node.initializer != nullptr));
+    if (node.initializer) node.initializer->accept(*this);
+    add((long)(node.condition != nullptr));
+    if (node.condition) node.condition->accept(*this);
+    add((long)(node.increment != nullptr));
+    if (node.increment) node.increment->accept(*this);
+    statements(node.body);
+    return 0;
+}
+
+long ASTFingerprint::visit(NumberExprAST& node) {
+    tag('N');
+    add(node.value);
+    return 0;
+}
+
+long ASTFingerprint::visit(VariableExprAST& node) {
+    tag('V');
+    add(node.name);
+    return 0;
+}
+
+long ASTFingerprint::visit(CallExprAST& node) {
+    tag('C');
+    add(node.callee);
+    add((long)node.tailCall);
+    add((long)node.recursive);
+    add((long)node.args.size());
+    for (auto& arg : node.args) {
+        arg->accept(*this);
+    }
+    calledFunctions.insert(node.callee);
+    return 0;
+}
+
+long ASTFingerprint::visit(BinaryExprAST& node) {
+    tag('B');
+    add((long)node.op);
+    node.left->accept(*this);
+    node.right->accept(*this);
+    return 0;
+}
+
+long ASTFingerprint::visit(FloatExprAST& node) {
+    tag('X');
+    // hex float, exact
+    char buffer[64];
+    std::snprintf(buffer, sizeof(buffer), "%a", node.value);
+    add(std::string(buffer));
+    return 0;
+}
+
+long ASTFingerprint::visit(StringExprAST& node) {
+    tag('S');
+    add(node.value);
+    return 0;
+}
+
+long ASTFingerprint::visit(CharExprAST& node) {
+    tag('H');
+    add((long)node.value);
+    return 0;
+}
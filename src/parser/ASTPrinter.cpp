@@ -50,7 +50,7 @@ long ASTPrinter::visit(FunctionAST& node) {
         params += node.parameters[i].first + " " + node.parameters[i].second;
         if (i < node.parameters.size() - 1) params += ", ";
     }
-    printNode("Function", node.returnType + " " + node.name + "(" + params + ")");
+    printNode("Function", (node.exported ? "export " : "") + node.returnType + " " + node.name + "(" + params + ")");
     
     for (size_t i = 0; i < node.body.size(); ++i) {
         increaseIndent(i == node.body.size() - 1);
@@ -237,7 +237,7 @@ long ASTPrinter::visit(VariableExprAST& node) {
 }
 
 long ASTPrinter::visit(CallExprAST& node) {
-    printNode("Call", node.callee);
+    printNode("Call", node.callee + (node.tailCall ? (node.recursive ? " [recursive tail]" : " [tail]") : ""));
     for (size_t i = 0; i < node.args.size(); ++i) {
         increaseIndent(i == node.args.size() - 1);
         node.args[i]->accept(*this);
@@ -0,0 +1,260 @@
+#include "parser/ModuleInterface.h"
+#include "lexer/Lexer.h"
+#include "parser/Parser.h"
+#include "support/OutputCapture.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/xxhash.h"
+#include <iostream>
+#include <set>
+
+namespace {
+    const char magic[] = {'P', 'M', 'I', 1};
+
+    // a byte per type in the file
+    const char* typeNames[] = {"int", "float", "double", "char", "string", "void"};
+    constexpr uint64_t typeCount = sizeof(typeNames) / sizeof(typeNames[0]);
+
+    uint8_t typeCode(const std::string& name) {
+        for (uint8_t code = 0; code < typeCount; code++) {
+            if (name == typeNames[code]) return code;
+        }
+        return 0;
+    }
+
+    void writeInt(std::string& out, uint64_t value, unsigned bytes) {
+        for (unsigned i = 0; i < bytes; i++) {
+            out += (char)((value >> (8 * i)) & 0xff);
+        }
+    }
+
+    // reads from data, false once it runs past the end
+    class Reader {
+        public:
+        Reader(llvm::StringRef data) : data(data) {}
+
+        bool readInt(uint64_t& value, unsigned bytes) {
+            if (position + bytes > data.size()) return false;
+            value = 0;
+            for (unsigned i = 0; i < bytes; i++) {
+                value |= (uint64_t)(uint8_t)data[position++] << (8 * i);
+            }
+            return true;
+        }
+
+        bool readString(std::string& value, size_t size) {
+            if (position + size > data.size()) return false;
+            value = data.substr(position, size).str();
+            position += size;
+            return true;
+        }
+
+        bool atEnd() const { return position == data.size(); }
+
+        private:
+        llvm::StringRef data;
+        size_t position = 0;
+    };
+}
+
+ModuleInterface ModuleInterface::of(const ProgramAST& program, llvm::StringRef source) {
+    ModuleInterface interface;
+    interface.sourceHash = llvm::xxh3_64bits(source);
+    for (const auto& func : program.functions) {
+        if (!func->exported) continue;
+        Function function{func->name, typeCode(func->returnType), {}};
+        for (const auto& param : func->parameters) {
+            function.paramTypes.push_back(typeCode(param.first));
+        }
+        interface.functions.push_back(function);
+    }
+    return interface;
+}
+
+std::string ModuleInterface::pathFor(const std::string& sourcePath) {
+    llvm::SmallString<128> path(sourcePath);
+    llvm::sys::path::replace_extension(path, "pmi");
+    return std::string(path);
+}
+
+std::string ModuleInterface::signatures() const {
+    std::string out;
+    writeInt(out, functions.size(), 4);
+    for (const auto& function : functions) {
+        writeInt(out, function.name.size(), 2);
+        out += function.name;
+        writeInt(out, function.returnType, 1);
+        writeInt(out, function.paramTypes.size(), 1);
+        for (uint8_t type : function.paramTypes) {
+            writeInt(out, type, 1);
+        }
+    }
+    return out;
+}
+
+bool ModuleInterface::write(const std::string& path) const {
+    std::string contents(magic, sizeof(magic));
+    writeInt(contents, sourceHash, 8);
+    contents += signatures();
+
+    // an unchanged file keeps its time stamp, build tools see nothing to do
+    if (auto existing = llvm::MemoryBuffer::getFile(path)) {
+        if ((*existing)->getBuffer() == contents) return true;
+    }
+
+    // modules compiled in parallel may write the same interface at once
+    llvm::SmallString<128> tmpPath;
+    llvm::sys::fs::createUniquePath(path + ".%%%%%%.tmp", tmpPath, false);
+    {
+        std::error_code EC;
+        llvm::raw_fd_ostream os(tmpPath, EC, llvm::sys::fs::OF_None);
+        if (EC) {
+            diagnostics() << "Warning: could not write module interface '" << path << "': " << EC.message() << "\n";
+            return false;
+        }
+        os << contents;
+    }
+    if (std::error_code EC = llvm::sys::fs::rename(tmpPath, path)) {
+        diagnostics() << "Warning: could not write module interface '" << path << "': " << EC.message() << "\n";
+        llvm::sys::fs::remove(tmpPath);
+        return false;
+    }
+    return true;
+}
+
+std::optional<ModuleInterface> ModuleInterface::read(const std::string& path) {
+    auto buffer = llvm::MemoryBuffer::getFile(path);
+    if (!buffer) return std::nullopt;
+    llvm::StringRef data = (*buffer)->getBuffer();
+    if (!data.starts_with(llvm::StringRef(magic, sizeof(magic)))) return std::nullopt;
+
+    Reader reader(data.drop_front(sizeof(magic)));
+    ModuleInterface interface;
+    uint64_t count;
+    if (!reader.readInt(interface.sourceHash, 8) || !reader.readInt(count, 4)) return std::nullopt;
+    for (uint64_t i = 0; i < count; i++) {
+        Function function;
+        uint64_t nameSize, returnType, paramCount;
+        if (!reader.readInt(nameSize, 2) || !reader.readString(function.name, nameSize) ||
+            !reader.readInt(returnType, 1) || returnType >= typeCount || !reader.readInt(paramCount, 1)) {
+            return std::nullopt;
+        }
+        function.returnType = returnType;
+        for (uint64_t p = 0; p < paramCount; p++) {
+            uint64_t type;
+            if (!reader.readInt(type, 1) || type >= typeCount) return std::nullopt;
+            function.paramTypes.push_back(type);
+        }
+        interface.functions.push_back(function);
+    }
+    if (!reader.atEnd()) return std::nullopt;
+    return interface;
+}
+
+bool ModuleInterface::matches(llvm::StringRef source) const {
+    return sourceHash == llvm::xxh3_64bits(source);
+}
+
+std::optional<ModuleInterface> ModuleInterface::forModule(const std::string& sourcePath) {
+    auto source = llvm::MemoryBuffer::getFile(sourcePath);
+    if (!source) {
+        std::cerr << "Error: Could not open module '" << sourcePath << "'\n";
+        return std::nullopt;
+    }
+    llvm::StringRef text = (*source)->getBuffer();
+
+    std::string interfacePath = pathFor(sourcePath);
+    std::optional<ModuleInterface> interface = read(interfacePath);
+    if (interface && interface->matches(text)) {
+        return interface;
+    }
+
+    // missing or out of date: the module's source has to be parsed once
+    Lexer lexer(text.str());
+    Parser parser(lexer.scanTokens());
+    std::unique_ptr<ProgramAST> program = parser.parse();
+    if (!program) {
+        std::cerr << "Error: Could not parse module '" << sourcePath << "'\n";
+        return std::nullopt;
+    }
+    interface = of(*program, text);
+    interface->write(interfacePath);
+    return interface;
+}
+
+std::vector<std::unique_ptr<FunctionAST>> ModuleInterface::declarations() const {
+    std::vector<std::unique_ptr<FunctionAST>> prototypes;
+    for (const auto& function : functions) {
+        std::vector<std::pair<std::string, std::string>> params;
+        for (size_t i = 0; i < function.paramTypes.size(); i++) {
+            params.push_back({typeNames[function.paramTypes[i]], "arg" + std::to_string(i)});
+        }
+        prototypes.push_back(std::make_unique<FunctionAST>(typeNames[function.returnType], function.name,
+                                                           std::move(params), std::vector<std::unique_ptr<StmtAST>>(),
+                                                           true));
+    }
+    return prototypes;
+}
+
+void writeInterface(const ProgramAST& program, llvm::StringRef source, const std::string& sourcePath) {
+    for (const auto& func : program.functions) {
+        if (func->exported) {
+            ModuleInterface::of(program, source).write(ModuleInterface::pathFor(sourcePath));
+            return;
+        }
+    }
+}
+
+void refreshInterface(llvm::StringRef source, const std::string& sourcePath) {
+    std::optional<ModuleInterface> interface = ModuleInterface::read(ModuleInterface::pathFor(sourcePath));
+    if (interface && interface->matches(source)) return;
+    Lexer lexer(source.str());
+    Parser parser(lexer.scanTokens());
+    std::unique_ptr<ProgramAST> program = parser.parse();
+    if (program) {
+        writeInterface(*program, source, sourcePath);
+    }
+}
+
+std::string resolveImport(const std::string& importer, const std::string& path) {
+    if (llvm::sys::path::is_absolute(path)) return path;
+    llvm::SmallString<128> resolved(llvm::sys::path::parent_path(importer));
+    llvm::sys::path::append(resolved, path);
+    return std::string(resolved);
+}
+
+bool resolveImports(ProgramAST& program, const std::string& sourcePath) {
+    bool ok = true;
+    std::set<std::string> loaded;
+    for (const auto& import : program.imports) {
+        std::string path = resolveImport(sourcePath, import);
+        if (!loaded.insert(path).second) continue;
+        std::optional<ModuleInterface> interface = ModuleInterface::forModule(path);
+        if (!interface) {
+            ok = false;
+            continue;
+        }
+        for (auto& prototype : interface->declarations()) {
+            program.imported.push_back(std::move(prototype));
+        }
+    }
+    return ok;
+}
+
+std::string importedSignatures(const std::string& source, const std::string& sourcePath) {
+    Lexer lexer(source);
+    std::vector<Token> tokens = lexer.scanTokens();
+    std::string result;
+    for (size_t i = 0; i + 1 < tokens.size(); i++) {
+        if (tokens[i].type != Tokentype::KW_IMPORT || tokens[i + 1].type != Tokentype::STRING_LITERAL) continue;
+        const std::string& lexeme = tokens[i + 1].lexeme;
+        std::string path = resolveImport(sourcePath, lexeme.substr(1, lexeme.size() - 2));
+        std::optional<ModuleInterface> interface = ModuleInterface::forModule(path);
+        result += path + "\n";
+        result += interface ? interface->signatures() : "missing";
+    }
+    return result;
+}
@@ -1,4 +1,5 @@
 #include "parser/Parser.h"
+#include "support/Timing.h"
 #include <stdexcept>
 #include <iostream>
 
@@ -6,21 +7,43 @@ Parser::Parser(const std::vector<Token>& tokens) : tokens(tokens) {}
 
 // main entry point 
 std::unique_ptr<ProgramAST> Parser::parse() {
+    PhaseScope phase("Parser");
     std::vector<std::unique_ptr<FunctionAST>> functions;
+    std::vector<std::string> imports;
     try{
         while (!isAtEnd()) {
-            functions.push_back(parseFunction());
+            if (match(Tokentype::KW_IMPORT)) {
+                imports.push_back(parseImport());
+            } else {
+                functions.push_back(parseFunction());
+            }
         }
-        return std::make_unique<ProgramAST>(std::move(functions));
+        auto program = std::make_unique<ProgramAST>(std::move(functions));
+        program->imports = std::move(imports);
+        return program;
     } catch(const std::exception& e) {
         std::cerr << "erroe :" << e.what() << std::endl;
         return nullptr;
     }
 }
 
+std::unique_ptr<FunctionAST> Parser::parseSingleFunction(std::string& error) {
+    try {
+        auto function = parseFunction();
+        if (!isAtEnd()) {
+            throw std::runtime_error("syntax error : unexpected " + peek().lexeme + " after function " + function->name);
+        }
+        return function;
+    } catch (const std::exception& e) {
+        error = e.what();
+        return nullptr;
+    }
+}
+
 // grammar parsing methods 
 
 std::unique_ptr<FunctionAST> Parser::parseFunction() {
+    bool exported = match(Tokentype::KW_EXPORT);
     std::string returnType = parseType();
 
     Token name = consume(Tokentype::IDENTIFIER, "expected function name.");
@@ -43,7 +66,15 @@ std::unique_ptr<FunctionAST> Parser::parseFunction() {
         body.push_back(parseStatement());
     }
 
-    return std::make_unique<FunctionAST>(returnType, name.lexeme, std::move(parameters), std::move(body));
+    return std::make_unique<FunctionAST>(returnType, name.lexeme, std::move(parameters), std::move(body), exported);
+}
+
+// import "path"; the keyword is already consumed
+std::string Parser::parseImport() {
+    Token path = consume(Tokentype::STRING_LITERAL, "Expected module path after 'import'.");
+    consume(Tokentype::SEMICOLON, "Expected ';' after import.");
+    // the lexeme keeps its quotes
+    return path.lexeme.substr(1, path.lexeme.size() - 2);
 }
 
 // base for parsing statements
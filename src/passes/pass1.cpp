@@ -1,29 +1,126 @@
 #include "passes/pass1.h"
+#include "support/OutputCapture.h"
+#include "llvm/Analysis/LoopInfo.h"
 #include "llvm/IR/BasicBlock.h"
 #include "llvm/IR/Instruction.h"
 #include "llvm/IR/Instructions.h"
-#include "llvm/Support/raw_ostream.h" // For errs()
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/raw_ostream.h"
 
 using namespace llvm;
 
-// Implement the 'run' method that was declared in the header
-PreservedAnalyses AddCounterPass::run(Function &F, FunctionAnalysisManager &AM) {
-    
-    errs() << "Analyzing function: " << F.getName() << "\n";
+AnalysisKey IRStatsAnalysis::Key;
+
+void IRStats::add(const IRStats &other) {
+    for (const auto &entry : other.opcodes) {
+        opcodes[entry.first] += entry.second;
+    }
+    basicBlocks += other.basicBlocks;
+    instructions += other.instructions;
+    allocas += other.allocas;
+    loads += other.loads;
+    stores += other.stores;
+    calls += other.calls;
+    loops += other.loops;
+}
+
+IRStats IRStatsAnalysis::run(Function &F, FunctionAnalysisManager &AM) {
+    IRStats stats;
 
-    unsigned addCount = 0;
     // Iterate over all basic blocks and instructions
     for (BasicBlock &BB : F) {
+        stats.basicBlocks++;
         for (Instruction &I : BB) {
-            if (I.getOpcode() == Instruction::Add) {
-                addCount++;
-            }
+            stats.instructions++;
+            stats.opcodes[I.getOpcodeName()]++;
+            if (isa<AllocaInst>(I)) stats.allocas++;
+            if (isa<LoadInst>(I)) stats.loads++;
+            if (isa<StoreInst>(I)) stats.stores++;
+            if (isa<CallBase>(I)) stats.calls++;
         }
     }
 
-    errs() << "  Found " << addCount << " ADD instructions.\n \n";
+    if (!F.isDeclaration()) {
+        LoopInfo &LI = AM.getResult<LoopAnalysis>(F);
+        stats.loops = LI.getLoopsInPreorder().size();
+    }
+    return stats;
+}
+
+void IRStatsRecorder::record(StringRef stage, const Function &F, const IRStats &stats) {
+    // stages interleave (irgen and function pipeline alternate per function)
+    for (auto &entry : stages) {
+        if (entry.first == stage) {
+            entry.second.push_back({F.getName().str(), stats});
+            return;
+        }
+    }
+    stages.push_back({stage.str(), {{F.getName().str(), stats}}});
+}
+
+static void writeStats(json::OStream &J, const IRStats &stats) {
+    J.attribute("basic_blocks", (int64_t)stats.basicBlocks);
+    J.attribute("instructions", (int64_t)stats.instructions);
+    J.attribute("allocas", (int64_t)stats.allocas);
+    J.attribute("loads", (int64_t)stats.loads);
+    J.attribute("stores", (int64_t)stats.stores);
+    J.attribute("calls", (int64_t)stats.calls);
+    J.attribute("loops", (int64_t)stats.loops);
+    J.attributeObject("opcodes", [&] {
+        for (const auto &entry : stats.opcodes) {
+            J.attribute(entry.first, (int64_t)entry.second);
+        }
+    });
+}
+
+bool IRStatsRecorder::writeJSON(const std::string &filename) const {
+    std::error_code EC;
+    raw_fd_ostream OS(filename, EC, sys::fs::OF_Text);
+    if (EC) {
+        diagnostics() << "Error: could not open '" << filename << "': " << EC.message() << "\n";
+        return false;
+    }
+
+    json::OStream J(OS, 2);
+    J.object([&] {
+        J.attributeArray("stages", [&] {
+            for (const auto &stage : stages) {
+                IRStats totals;
+                J.object([&] {
+                    J.attribute("stage", stage.first);
+                    J.attributeArray("functions", [&] {
+                        for (const auto &function : stage.second) {
+                            totals.add(function.second);
+                            J.object([&] {
+                                J.attribute("name", function.first);
+                                writeStats(J, function.second);
+                            });
+                        }
+                    });
+                    J.attributeObject("totals", [&] { writeStats(J, totals); });
+                });
+            }
+        });
+    });
+    OS << "\n";
+    return true;
+}
+
+// Implement the 'run' method that was declared in the header
+PreservedAnalyses AddCounterPass::run(Function &F, FunctionAnalysisManager &AM) {
+
+    diagnostics() << "Analyzing function: " << F.getName() << "\n";
+
+    const IRStats &stats = AM.getResult<IRStatsAnalysis>(F);
+    diagnostics() << "  " << stats.basicBlocks << " blocks, " << stats.instructions << " instructions, "
+           << stats.loops << " loops\n";
+    for (const auto &entry : stats.opcodes) {
+        diagnostics() << "    " << entry.first << ": " << entry.second << "\n";
+    }
+    diagnostics() << "\n";
 
-    // Since we only read the IR and didn't modify it, 
+    // Since we only read the IR and didn't modify it,
     // all analyses remain valid.
     return PreservedAnalyses::all();
 }
@@ -1,59 +1,156 @@
 #include "passes/pass2.h"
+#include "support/OutputCapture.h"
+#include "llvm/IR/Attributes.h"
 #include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/Instructions.h"
-#include "llvm/IR/Intrinsics.h"
 #include "llvm/Support/raw_ostream.h"
 
 using namespace llvm;
 
-PreservedAnalyses UnusedArgElimPass::run(Function &F, FunctionAnalysisManager &AM) {
-    bool modified = false;
-    
+// true if every use of F is a plain direct call we know how to rewrite
+static bool canRewrite(Function &F) {
+    if (F.isDeclaration() || !F.hasLocalLinkage() || F.isVarArg()) return false;
+
+    for (Use &U : F.uses()) {
+        auto *CI = dyn_cast<CallInst>(U.getUser());
+        // address taken, or passed along as an argument
+        if (!CI || !CI->isCallee(&U)) return false;
+        if (CI->getFunctionType() != F.getFunctionType()) return false;
+        // musttail needs caller and callee prototypes to match
+        if (CI->isMustTailCall()) return false;
+    }
+
+    for (BasicBlock &BB : F) {
+        for (Instruction &I : BB) {
+            if (auto *CI = dyn_cast<CallInst>(&I)) {
+                if (CI->isMustTailCall()) return false;
+            }
+        }
+    }
+    return true;
+}
+
+// rebuilds an attribute list keeping only the surviving parameters
+static AttributeList dropAttributes(LLVMContext &Ctx, AttributeList PAL,
+                                    const std::vector<unsigned> &kept, bool dropReturn) {
+    SmallVector<AttributeSet, 8> paramAttrs;
+    for (unsigned i : kept) {
+        paramAttrs.push_back(PAL.getParamAttrs(i));
+    }
+    AttributeSet retAttrs = dropReturn ? AttributeSet() : PAL.getRetAttrs();
+    return AttributeList::get(Ctx, PAL.getFnAttrs(), retAttrs, paramAttrs);
+}
+
+static bool eliminateUnused(Function &F, FunctionAnalysisManager &FAM) {
+    LLVMContext &Ctx = F.getContext();
+    FunctionType *oldFT = F.getFunctionType();
+
     // We need to keep track of which arguments are actually used
-    std::vector<unsigned> unusedArgIndices;
+    std::vector<unsigned> kept;
     std::vector<Type*> newParamTypes;
-
-    // Iterate through all arguments of the function F
     for (unsigned i = 0; i < F.arg_size(); ++i) {
-        Argument* Arg = F.getArg(i);
-        
-        // If an argument has NO users in the entire module, it's unused.
-        if (Arg->use_empty()) {
-            unusedArgIndices.push_back(i);
-            modified = true;
-            errs() << "Removing unused argument: " << Arg->getName() << " from function " << F.getName() << "\n";
-        } else {
-            // If it is used, we must keep its type in the new function signature
-            newParamTypes.push_back(Arg->getType());
+        if (!F.getArg(i)->use_empty()) {
+            kept.push_back(i);
+            newParamTypes.push_back(F.getArg(i)->getType());
         }
     }
 
-    // If we didn't find any unused arguments, we return early and preserve everything
-    if (!modified) {
-        return PreservedAnalyses::all();
+    // the return value is dead when no caller reads it
+    bool dropReturn = !oldFT->getReturnType()->isVoidTy();
+    for (User *U : F.users()) {
+        if (!U->use_empty()) {
+            dropReturn = false;
+            break;
+        }
+    }
+
+    // If we didn't find anything to remove we leave the function alone
+    if (kept.size() == F.arg_size() && !dropReturn) {
+        return false;
+    }
+
+    diagnostics() << "Removing " << (F.arg_size() - kept.size()) << " unused argument(s)"
+           << (dropReturn ? " and the unused return value" : "") << " from function " << F.getName() << "\n";
+
+    // 1. Create a new FunctionType with the reduced signature
+    Type *retType = dropReturn ? Type::getVoidTy(Ctx) : oldFT->getReturnType();
+    FunctionType *newFT = FunctionType::get(retType, newParamTypes, false);
+
+    // 2. Create the new function right next to the old one
+    Function *newF = Function::Create(newFT, F.getLinkage(), F.getAddressSpace());
+    newF->copyAttributesFrom(&F);
+    newF->setAttributes(dropAttributes(Ctx, F.getAttributes(), kept, dropReturn));
+    newF->setComdat(F.getComdat());
+    F.getParent()->getFunctionList().insert(F.getIterator(), newF);
+    newF->takeName(&F);
+
+    // 3. Move the body over and remap the surviving arguments
+    newF->splice(newF->begin(), &F);
+    for (unsigned i = 0; i < kept.size(); ++i) {
+        Argument *oldArg = F.getArg(kept[i]);
+        Argument *newArg = newF->getArg(i);
+        oldArg->replaceAllUsesWith(newArg);
+        newArg->takeName(oldArg);
     }
 
-    // --- IR Modification Steps (The tricky part) ---
-    
-    // 1. Create a new FunctionType with the reduced parameters
-    FunctionType* oldFT = F.getFunctionType();
-    FunctionType* newFT = FunctionType::get(oldFT->getReturnType(), newParamTypes, oldFT->isVarArg());
+    if (dropReturn) {
+        for (BasicBlock &BB : *newF) {
+            if (auto *RI = dyn_cast<ReturnInst>(BB.getTerminator())) {
+                IRBuilder<> builder(RI);
+                builder.CreateRetVoid();
+                RI->eraseFromParent();
+            }
+        }
+    }
 
-    // 2. Create the new function with the new signature
-    Function* newF = Function::Create(newFT, F.getLinkage(), F.getAddressSpace(), F.getName(), F.getParent());
-    
-     // While the blocks are still attached to F, move them to the end of newF
-    while (!F.empty()) {
-        BasicBlock *BB = &F.front();
-        BB->removeFromParent();
-        BB->insertInto(newF); // This is the public method name in many versions of LLVM
+    // 4. Rewrite every call site to the new signature
+    for (User *U : make_early_inc_range(F.users())) {
+        auto *CI = cast<CallInst>(U);
+        std::vector<Value*> args;
+        for (unsigned i : kept) {
+            args.push_back(CI->getArgOperand(i));
+        }
+
+        IRBuilder<> builder(CI);
+        CallInst *newCall = builder.CreateCall(newF, args);
+        newCall->setCallingConv(CI->getCallingConv());
+        newCall->setTailCallKind(CI->getTailCallKind());
+        newCall->setAttributes(dropAttributes(Ctx, CI->getAttributes(), kept, dropReturn));
+        newCall->setDebugLoc(CI->getDebugLoc());
+        if (!dropReturn) {
+            CI->replaceAllUsesWith(newCall);
+            newCall->takeName(CI);
+        }
+        CI->eraseFromParent();
     }
 
-    // 4. Update all callers of the old function to point to the new function
-    F.replaceAllUsesWith(newF);
-    
-    // 5. Remove the old function declaration from the module
+    // 5. Remove the old function, nothing refers to it anymore
+    FAM.clear(F, F.getName());
     F.eraseFromParent();
-    
+    return true;
+}
+
+PreservedAnalyses UnusedArgElimPass::run(Module &M, ModuleAnalysisManager &AM) {
+    FunctionAnalysisManager &FAM = AM.getResult<FunctionAnalysisManagerModuleProxy>(M).getManager();
+
+    // removing an argument can make the caller's own argument dead, so repeat
+    bool modified = false;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        std::vector<Function*> candidates;
+        for (Function &F : M) {
+            if (canRewrite(F)) candidates.push_back(&F);
+        }
+        for (Function *F : candidates) {
+            changed |= eliminateUnused(*F, FAM);
+        }
+        modified |= changed;
+    }
+
+    if (!modified) {
+        return PreservedAnalyses::all();
+    }
     return PreservedAnalyses::none(); 
-}
\ No newline at end of file
+}
@@ -0,0 +1,84 @@
+#include "passes/pass3.h"
+#include "llvm/ADT/SetVector.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
+
+using namespace llvm;
+
+// counter += 1, and call the tier up hook the moment it hits the threshold
+static void emitCount(Instruction *before, GlobalVariable *counter, FunctionCallee tierUp,
+                      uint64_t threshold, unsigned id) {
+    IRBuilder<> builder(before);
+    Type *i64 = builder.getInt64Ty();
+    Value *count = builder.CreateLoad(i64, counter, "tier.count");
+    Value *next = builder.CreateAdd(count, ConstantInt::get(i64, 1));
+    builder.CreateStore(next, counter);
+    Value *hot = builder.CreateICmpEQ(next, ConstantInt::get(i64, threshold), "tier.hot");
+
+    Instruction *then = SplitBlockAndInsertIfThen(hot, before, false);
+    builder.SetInsertPoint(then);
+    builder.CreateCall(tierUp, {ConstantInt::get(i64, id)});
+}
+
+PreservedAnalyses TierInstrumentPass::run(Module &M, ModuleAnalysisManager &AM) {
+    FunctionAnalysisManager &FAM = AM.getResult<FunctionAnalysisManagerModuleProxy>(M).getManager();
+    LLVMContext &Ctx = M.getContext();
+    Type *i64 = Type::getInt64Ty(Ctx);
+    PointerType *ptr = PointerType::getUnqual(Ctx);
+    FunctionCallee tierUp = M.getOrInsertFunction("__pilla_tier_up", Type::getVoidTy(Ctx), i64);
+
+    std::vector<Function*> functions;
+    for (Function &F : M) {
+        if (!F.isDeclaration()) functions.push_back(&F);
+    }
+
+    for (Function *F : functions) {
+        unsigned id = instrumented->size();
+        instrumented->push_back(F->getName().str());
+
+        auto *slot = new GlobalVariable(M, ptr, false, GlobalValue::ExternalLinkage, F,
+                                        "__pilla_tier." + F->getName());
+        auto *counter = new GlobalVariable(M, i64, false, GlobalValue::ExternalLinkage,
+                                           ConstantInt::get(i64, 0), "__pilla_count." + F->getName());
+        auto *calls = new GlobalVariable(M, i64, false, GlobalValue::ExternalLinkage,
+                                         ConstantInt::get(i64, 0), "__pilla_calls." + F->getName());
+
+        // loop latches first, splitting the entry block would change the loops
+        LoopInfo &LI = FAM.getResult<LoopAnalysis>(*F);
+        SmallVector<BasicBlock*, 8> latchBlocks;
+        for (Loop *L : LI.getLoopsInPreorder()) {
+            L->getLoopLatches(latchBlocks);
+        }
+        SmallSetVector<BasicBlock*, 8> latches(latchBlocks.begin(), latchBlocks.end());
+        for (BasicBlock *latch : latches) {
+            emitCount(latch->getTerminator(), counter, tierUp, threshold, id);
+        }
+
+        // entry: after the allocas so they stay static
+        BasicBlock &entry = F->getEntryBlock();
+        Instruction *first = &*entry.getFirstNonPHIOrDbgOrAlloca();
+        {
+            IRBuilder<> builder(first);
+            Value *count = builder.CreateLoad(i64, calls, "tier.calls");
+            builder.CreateStore(builder.CreateAdd(count, ConstantInt::get(i64, 1)), calls);
+        }
+        emitCount(first, counter, tierUp, threshold, id);
+
+        // every direct call goes through the slot
+        for (User *U : make_early_inc_range(F->users())) {
+            auto *call = dyn_cast<CallInst>(U);
+            if (!call || call->getCalledFunction() != F) continue;
+            IRBuilder<> builder(call);
+            LoadInst *target = builder.CreateAlignedLoad(ptr, slot, Align(8), "tier.target");
+            target->setAtomic(AtomicOrdering::Monotonic);
+            call->setCalledOperand(target);
+        }
+        FAM.invalidate(*F, PreservedAnalyses::none());
+    }
+
+    return PreservedAnalyses::none();
+}
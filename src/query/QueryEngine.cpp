@@ -0,0 +1,277 @@
+#include "query/QueryEngine.h"
+#include "lexer/Lexer.h"
+#include "parser/ModuleInterface.h"
+#include "parser/Parser.h"
+#include "support/Timing.h"
+#include "llvm/Support/Format.h"
+#include <utility>
+
+namespace {
+    // index after the function starting at begin: after the brace closing its
+    // body, or the E_O_F token when the body is not closed
+    size_t functionEnd(const std::vector<Token>& tokens, size_t begin) {
+        int depth = 0;
+        bool inBody = false;
+        for (size_t i = begin; i < tokens.size(); i++) {
+            if (tokens[i].type == Tokentype::E_O_F) return i;
+            if (tokens[i].type == Tokentype::LBRACE) {
+                depth++;
+                inBody = true;
+            } else if (tokens[i].type == Tokentype::RBRACE && inBody && --depth == 0) {
+                return i + 1;
+            }
+        }
+        return tokens.size() - 1;
+    }
+
+    // line and column are left out, moving a function does not change it
+    std::string tokenKey(const std::vector<Token>& tokens, size_t begin, size_t end) {
+        std::string key;
+        for (size_t i = begin; i < end; i++) {
+            key += std::to_string((int)tokens[i].type);
+            key += ' ';
+            key += std::to_string(tokens[i].lexeme.size());
+            key += ':';
+            key += tokens[i].lexeme;
+        }
+        return key;
+    }
+
+    std::string signatureKey(const FunctionAST& function) {
+        std::string key = function.returnType + "(";
+        for (const auto& param : function.parameters) {
+            key += param.first + ",";
+        }
+        return key + ")";
+    }
+}
+
+QueryEngine::FileQueries& QueryEngine::file(const std::string& path) {
+    return files[path];
+}
+
+void QueryEngine::setFileText(const std::string& path, const std::string& text) {
+    FileQueries& entry = file(path);
+    if (entry.tokensValid && entry.text == text) return;
+    entry.text = text;
+    entry.tokensValid = false;
+    entry.functionsValid = false;
+}
+
+const std::vector<Token>& QueryEngine::tokensOf(const std::string& path) {
+    FileQueries& entry = file(path);
+    if (entry.tokensValid) {
+        tokenStats.reused++;
+        return entry.tokens;
+    }
+    Lexer lexer(entry.text);
+    entry.tokens = lexer.scanTokens();
+    entry.tokensValid = true;
+    tokenStats.runs++;
+    return entry.tokens;
+}
+
+ProgramAST& QueryEngine::programOf(const std::string& path) {
+    FileQueries& entry = file(path);
+    if (!entry.functionsValid) {
+        tokensOf(path);
+        updateFunctions(entry);
+    }
+    return *entry.program;
+}
+
+void QueryEngine::updateFunctions(FileQueries& entry) {
+    PhaseScope phase("Parser");
+
+    // the functions of the previous text by token key, each with the AST it
+    // owned (the ProgramAST holds the ASTs of the functions that parsed)
+    std::vector<std::unique_ptr<FunctionAST>> previousASTs;
+    if (entry.program) {
+        previousASTs = std::move(entry.program->functions);
+    }
+    std::multimap<std::string, std::pair<std::unique_ptr<FunctionQueries>, std::unique_ptr<FunctionAST>>> previous;
+    size_t nextAST = 0;
+    for (auto& function : entry.functions) {
+        std::unique_ptr<FunctionAST> ast;
+        if (function->ast) {
+            ast = std::move(previousASTs[nextAST++]);
+        }
+        std::string key = function->tokenKey;
+        previous.emplace(key, std::make_pair(std::move(function), std::move(ast)));
+    }
+    entry.functions.clear();
+    entry.imports.clear();
+
+    const std::vector<Token>& tokens = entry.tokens;
+    std::vector<std::unique_ptr<FunctionAST>> asts;
+    size_t begin = 0;
+    while (tokens[begin].type != Tokentype::E_O_F) {
+        // import "path"; up to the next ';'
+        if (tokens[begin].type == Tokentype::KW_IMPORT) {
+            size_t end = begin + 1;
+            while (tokens[end].type != Tokentype::SEMICOLON && tokens[end].type != Tokentype::E_O_F) {
+                end++;
+            }
+            if (end == begin + 2 && tokens[begin + 1].type == Tokentype::STRING_LITERAL) {
+                const std::string& lexeme = tokens[begin + 1].lexeme;
+                entry.imports.push_back({lexeme.substr(1, lexeme.size() - 2), tokens[begin].line});
+            } else {
+                auto function = std::make_unique<FunctionQueries>();
+                function->line = tokens[begin].line;
+                function->syntaxError = "[Syntax Error] expected import \"<path>\";";
+                entry.functions.push_back(std::move(function));
+            }
+            begin = tokens[end].type == Tokentype::SEMICOLON ? end + 1 : end;
+            continue;
+        }
+
+        size_t end = functionEnd(tokens, begin);
+        std::string key = tokenKey(tokens, begin, end);
+
+        std::unique_ptr<FunctionQueries> function;
+        std::unique_ptr<FunctionAST> ast;
+        auto found = previous.find(key);
+        if (found != previous.end()) {
+            function = std::move(found->second.first);
+            ast = std::move(found->second.second);
+            previous.erase(found);
+            astStats.reused++;
+            signatureStats.reused++;
+        } else {
+            function = std::make_unique<FunctionQueries>();
+            function->tokenKey = key;
+            std::vector<Token> slice(tokens.begin() + begin, tokens.begin() + end);
+            slice.push_back(tokens.back());
+            Parser parser(slice);
+            std::string error;
+            ast = parser.parseSingleFunction(error);
+            astStats.runs++;
+            if (ast) {
+                function->signature = Semantics::signatureOf(*ast);
+                function->signatureKey = signatureKey(*ast);
+                signatureStats.runs++;
+            } else {
+                function->syntaxError = "[Syntax Error] " + error;
+            }
+        }
+
+        function->line = tokens[begin].line;
+        function->ast = ast.get();
+        if (ast) {
+            asts.push_back(std::move(ast));
+        }
+        entry.functions.push_back(std::move(function));
+        begin = end;
+    }
+
+    entry.program = std::make_unique<ProgramAST>(std::move(asts));
+    entry.functionsValid = true;
+}
+
+void QueryEngine::updateTypes(FileQueries& entry) {
+    PhaseScope phase("Semantics");
+
+    // the first function of a name wins, like in Semantics::getFunction
+    Semantics::FunctionTable table;
+    std::map<std::string, std::string> signatures;
+    for (const auto& function : entry.functions) {
+        if (!function->ast) continue;
+        table.push_back({function->ast->name, function->signature});
+        signatures.insert({function->ast->name, function->signatureKey});
+    }
+    for (const auto& prototype : entry.program->imported) {
+        table.push_back({prototype->name, Semantics::signatureOf(*prototype)});
+        signatures.insert({prototype->name, signatureKey(*prototype)});
+    }
+    auto currentSignature = [&](const std::string& name) {
+        auto found = signatures.find(name);
+        return found == signatures.end() ? std::string() : found->second;
+    };
+
+    Semantics sema;
+    Semantics::CallGraph callGraph;
+    Semantics::TailCalls tailCalls;
+    for (auto& function : entry.functions) {
+        if (!function->ast) continue;
+
+        bool valid = function->typesValid;
+        for (auto it = function->dependencies.begin(); valid && it != function->dependencies.end(); ++it) {
+            valid = currentSignature(it->first) == it->second;
+        }
+
+        if (valid) {
+            typeStats.reused++;
+        } else {
+            function->semanticErrors.clear();
+            function->typesOk = sema.analyzeFunction(*function->ast, table, function->semanticErrors);
+            function->dependencies.clear();
+            for (const auto& name : sema.getLookups()) {
+                function->dependencies[name] = currentSignature(name);
+            }
+            function->callGraph = sema.getCallGraph();
+            function->tailCalls = sema.getTailCalls();
+            function->typesValid = true;
+            typeStats.runs++;
+        }
+
+        for (const auto& calls : function->callGraph) {
+            auto& callees = callGraph[calls.first];
+            callees.insert(callees.end(), calls.second.begin(), calls.second.end());
+        }
+        tailCalls.insert(tailCalls.end(), function->tailCalls.begin(), function->tailCalls.end());
+    }
+
+    // whether a tail call is recursive depends on the whole call graph, it is
+    // cheap enough to redo every time
+    Semantics::markRecursiveTailCalls(callGraph, tailCalls);
+}
+
+bool QueryEngine::check(const std::string& path, std::vector<std::string>& diagnostics) {
+    programOf(path);
+    FileQueries& entry = file(path);
+
+    // interfaces are read on every check: they are small, and the imported
+    // module may have changed on disk without this file changing
+    bool ok = true;
+    entry.program->imports.clear();
+    entry.program->imported.clear();
+    for (const auto& import : entry.imports) {
+        entry.program->imports.push_back(import.first);
+        std::optional<ModuleInterface> interface = ModuleInterface::forModule(resolveImport(path, import.first));
+        if (!interface) {
+            diagnostics.push_back(path + ":" + std::to_string(import.second) +
+                                  ": [Import Error] could not load module '" + import.first + "'");
+            ok = false;
+            continue;
+        }
+        for (auto& prototype : interface->declarations()) {
+            entry.program->imported.push_back(std::move(prototype));
+        }
+    }
+    updateTypes(entry);
+
+    for (const auto& function : entry.functions) {
+        std::string where = path + ":" + std::to_string(function->line) + ": ";
+        if (!function->ast) {
+            diagnostics.push_back(where + function->syntaxError);
+            ok = false;
+            continue;
+        }
+        for (const auto& message : function->semanticErrors) {
+            diagnostics.push_back(where + message);
+        }
+        ok = ok && function->typesOk;
+    }
+    return ok;
+}
+
+void QueryEngine::printStats(llvm::raw_ostream& os) const {
+    os << "Front end queries (" << files.size() << (files.size() == 1 ? " file" : " files") << "):\n";
+    auto row = [&](const char* name, const QueryStats& stats) {
+        os << llvm::format("  %-24s %8u runs %8u reused\n", name, stats.runs, stats.reused);
+    };
+    row("tokens-of-file", tokenStats);
+    row("ast-of-function", astStats);
+    row("signature-of-function", signatureStats);
+    row("types-of-function-body", typeStats);
+}
@@ -1,14 +1,35 @@
 #include "sema/Sema.h"
+#include "support/Timing.h"
+#include <algorithm>
+#include <functional>
 #include <iostream>
 
 bool Semantics::analyze(ProgramAST& program) {
+    PhaseScope phase("Semantics");
     hasError = false;
     functions.clear();
     scopes.clear();
+    callGraph.clear();
+    tailCalls.clear();
     program.accept(*this);
     return !hasError;
 }
 
+bool Semantics::analyzeFunction(FunctionAST& function, const FunctionTable& table,
+                                std::vector<std::string>& messages) {
+    hasError = false;
+    scopes.clear();
+    callGraph.clear();
+    tailCalls.clear();
+    lookups.clear();
+    declared = &table;
+    diagnostics = &messages;
+    function.accept(*this);
+    declared = &functions;
+    diagnostics = nullptr;
+    return !hasError;
+}
+
 Type stringToType(const std::string& typeName) {
     if (typeName == "int") return Type::Int;
     if (typeName == "float") return Type::Float;
@@ -20,29 +41,45 @@ Type stringToType(const std::string& typeName) {
 }
 
 void Semantics::error(const std::string& message) {
-    std::cerr << "[Semantic Error] " << message << std::endl;
+    if (diagnostics) {
+        diagnostics->push_back("[Semantic Error] " + message);
+    } else {
+        std::cerr << "[Semantic Error] " << message << std::endl;
+    }
     hasError = true;
 }
 
+Semantics::FunctionInfo Semantics::signatureOf(const FunctionAST& function) {
+    std::vector<Type> paramTypes;
+    for (const auto& param : function.parameters) {
+        paramTypes.push_back(stringToType(param.first));
+    }
+    return {stringToType(function.returnType), paramTypes};
+}
+
 long Semantics::visit(ProgramAST& node) {
     // First pass: declare all functions
-    for (const auto& func : node.functions) {
-        std::vector<Type> paramTypes;
-        for (const auto& param : func->parameters) {
-            paramTypes.push_back(stringToType(param.first)); 
+    // imported ones after the module's own, the first declaration of a name wins
+    for (const auto* list : {&node.functions, &node.imported}) {
+        for (const auto& func : *list) {
+            FunctionInfo info = signatureOf(*func);
+            declareFunction(func->name, info.returnType, info.paramTypes);
         }
-        declareFunction(func->name, stringToType(func->returnType), paramTypes);
     }
 
     // Second pass: analyze function bodies
     for (const auto& func : node.functions) {
         func->accept(*this);
     }
+
+    markRecursiveTailCalls(callGraph, tailCalls);
     return 0;
 }
 
 long Semantics::visit(FunctionAST& node) {
     currentReturntype = stringToType(node.returnType); 
+    currentFunction = node.name;
+    callGraph[node.name];
     enterScope();
     
     // Declare parameters in scope
@@ -77,6 +114,14 @@ long Semantics::visit(VariableDeclAST& node) {
 
 long Semantics::visit(ReturnStmtAST& node) {
     node.expression->accept(*this);
+
+    // return f(...) : nothing is left to do in this frame after the call
+    if (auto* call = dynamic_cast<CallExprAST*>(node.expression.get())) {
+        if (call->callee != "printf" && getFunction(call->callee)) {
+            call->tailCall = true;
+            tailCalls.push_back({currentFunction, call});
+        }
+    }
     // Check return type (assuming int for now)
     return 0;
 }
@@ -214,6 +259,7 @@ long Semantics::visit(CallExprAST& node) {
     if (node.args.size() != func->paramTypes.size()) {
         error("Incorrect number of arguments for function " + node.callee);
     }
+    callGraph[currentFunction].push_back(node.callee);
     
     for (const auto& arg : node.args) {
         arg->accept(*this);
@@ -223,6 +269,53 @@ long Semantics::visit(CallExprAST& node) {
     return 0;
 }
 
+// a tail call is recursive when caller and callee are in the same strongly
+// connected component of the call graph (tarjan)
+void Semantics::markRecursiveTailCalls(const CallGraph& callGraph, const TailCalls& tailCalls) {
+    std::map<std::string, unsigned> index, lowlink, component;
+    std::map<std::string, bool> onStack;
+    std::vector<std::string> stack;
+    unsigned nextIndex = 0;
+    unsigned nextComponent = 0;
+
+    std::function<void(const std::string&)> connect = [&](const std::string& name) {
+        index[name] = lowlink[name] = nextIndex++;
+        stack.push_back(name);
+        onStack[name] = true;
+
+        auto calls = callGraph.find(name);
+        static const std::vector<std::string> noCalls;
+        for (const auto& callee : calls == callGraph.end() ? noCalls : calls->second) {
+            if (!index.count(callee)) {
+                connect(callee);
+                lowlink[name] = std::min(lowlink[name], lowlink[callee]);
+            } else if (onStack[callee]) {
+                lowlink[name] = std::min(lowlink[name], index[callee]);
+            }
+        }
+
+        if (lowlink[name] == index[name]) {
+            std::string member;
+            do {
+                member = stack.back();
+                stack.pop_back();
+                onStack[member] = false;
+                component[member] = nextComponent;
+            } while (member != name);
+            nextComponent++;
+        }
+    };
+
+    for (const auto& entry : callGraph) {
+        if (!index.count(entry.first)) connect(entry.first);
+    }
+
+    for (const auto& tailCall : tailCalls) {
+        CallExprAST* call = tailCall.second;
+        call->recursive = component[tailCall.first] == component[call->callee];
+    }
+}
+
 // Symbol table helpers
 
 void Semantics::enterScope() {
@@ -252,7 +345,8 @@ void Semantics::declareFunction(const std::string& name, Type returnType, const
 }
 
 std::optional<Semantics::FunctionInfo> Semantics::getFunction(const std::string& name) {
-    for (const auto& func : functions) {
+    lookups.insert(name);
+    for (const auto& func : *declared) {
         if (func.first == name) return func.second;
     }
     return std::nullopt;
@@ -0,0 +1,159 @@
+#include "support/MemReport.h"
+#include "llvm/Support/raw_ostream.h"
+#include <sys/resource.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace {
+    std::atomic<bool> enabled{false};
+
+    std::atomic<uint64_t> totalAllocs{0};
+    std::atomic<uint64_t> totalAllocBytes{0};
+    std::atomic<uint64_t> totalFreedBytes{0};
+
+    // what this thread allocated and freed. scopes take differences of these,
+    // so phases running on other threads (batch mode, -fparallel-codegen) are
+    // not charged to them
+    thread_local uint64_t threadAllocs = 0;
+    thread_local uint64_t threadAllocBytes = 0;
+    thread_local uint64_t threadFreedBytes = 0;
+
+    struct PhaseStats {
+        std::string name;
+        unsigned runs = 0;
+        uint64_t allocs = 0;
+        uint64_t allocBytes = 0;
+        uint64_t freedBytes = 0;
+        long rssGrowthKB = 0;
+        long peakRSSKB = 0;
+    };
+
+    std::mutex statsMutex;
+    std::vector<PhaseStats> phases;
+
+    thread_local MemScope* currentScope = nullptr;
+
+    long peakRSS() {
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return usage.ru_maxrss; // KB on linux
+    }
+
+    double megabytes(uint64_t bytes) {
+        return bytes / (1024.0 * 1024.0);
+    }
+
+    // memory allocated before the report was enabled is counted when it is
+    // freed, which would make a phase look like it gave back more than it took
+    double keptMegabytes(uint64_t allocBytes, uint64_t freedBytes) {
+        return allocBytes > freedBytes ? megabytes(allocBytes - freedBytes) : 0.0;
+    }
+}
+
+void countAllocation(std::size_t usableSize) {
+    totalAllocs.fetch_add(1, std::memory_order_relaxed);
+    totalAllocBytes.fetch_add(usableSize, std::memory_order_relaxed);
+    threadAllocs++;
+    threadAllocBytes += usableSize;
+}
+
+void countFree(std::size_t usableSize) {
+    totalFreedBytes.fetch_add(usableSize, std::memory_order_relaxed);
+    threadFreedBytes += usableSize;
+}
+
+void enableMemReport() {
+    enabled = true;
+}
+
+bool memReportEnabled() {
+    return enabled.load(std::memory_order_relaxed);
+}
+
+MemScope::MemScope(llvm::StringRef name) : active(enabled) {
+    if (!active) return;
+
+    {
+        std::lock_guard<std::mutex> lock(statsMutex);
+        for (phase = 0; phase < phases.size(); phase++) {
+            if (phases[phase].name == name) break;
+        }
+        if (phase == phases.size()) {
+            phases.push_back({name.str()});
+        }
+    }
+
+    parent = currentScope;
+    currentScope = this;
+    startRSS = peakRSS();
+    allocs = threadAllocs;
+    allocBytes = threadAllocBytes;
+    freedBytes = threadFreedBytes;
+}
+
+MemScope::~MemScope() {
+    if (!active) return;
+
+    // inclusive numbers for this scope
+    uint64_t scopeAllocs = threadAllocs - allocs;
+    uint64_t scopeAllocBytes = threadAllocBytes - allocBytes;
+    uint64_t scopeFreedBytes = threadFreedBytes - freedBytes;
+    long rss = peakRSS();
+
+    currentScope = parent;
+    if (parent) {
+        parent->childAllocs += scopeAllocs;
+        parent->childAllocBytes += scopeAllocBytes;
+        parent->childFreedBytes += scopeFreedBytes;
+    }
+
+    std::lock_guard<std::mutex> lock(statsMutex);
+    PhaseStats& stats = phases[phase];
+    stats.runs++;
+    stats.allocs += scopeAllocs - childAllocs;
+    stats.allocBytes += scopeAllocBytes - childAllocBytes;
+    stats.freedBytes += scopeFreedBytes - childFreedBytes;
+    stats.rssGrowthKB += rss - startRSS;
+    stats.peakRSSKB = std::max(stats.peakRSSKB, rss);
+}
+
+void printMemReport() {
+    if (!enabled) return;
+
+    llvm::raw_ostream& os = llvm::errs();
+    os << "===" << std::string(73, '-') << "===\n";
+    os << "                          Pilla memory report\n";
+    os << "===" << std::string(73, '-') << "===\n";
+    char row[160];
+    std::snprintf(row, sizeof(row), "  %-18s %6s %10s %11s %11s %11s %11s %11s\n", "Phase", "Runs", "Allocs",
+                  "Alloc (MB)", "Freed (MB)", "Kept (MB)", "RSS + (MB)", "Peak (MB)");
+    os << row;
+
+    std::lock_guard<std::mutex> lock(statsMutex);
+    for (const auto& stats : phases) {
+        double kept = keptMegabytes(stats.allocBytes, stats.freedBytes);
+        std::snprintf(row, sizeof(row), "  %-18s %6u %10llu %11.2f %11.2f %11.2f %11.1f %11.1f\n",
+                      stats.name.c_str(), stats.runs, (unsigned long long)stats.allocs,
+                      megabytes(stats.allocBytes), megabytes(stats.freedBytes), kept,
+                      stats.rssGrowthKB / 1024.0, stats.peakRSSKB / 1024.0);
+        os << row;
+    }
+
+    uint64_t allocBytes = totalAllocBytes.load();
+    uint64_t freedBytes = totalFreedBytes.load();
+    std::snprintf(row, sizeof(row), "  %-18s %6s %10llu %11.2f %11.2f %11.2f %11s %11.1f\n", "Total", "",
+                  (unsigned long long)totalAllocs.load(), megabytes(allocBytes), megabytes(freedBytes),
+                  keptMegabytes(allocBytes, freedBytes), "", peakRSS() / 1024.0);
+    os << row;
+    os << "\n  Kept = bytes allocated in the phase minus bytes freed in it, i.e. what the\n"
+       << "  phase leaves behind (tokens, AST, module). RSS + = growth of the peak RSS\n"
+       << "  while the phase ran, it is per process, so phases running at the same time\n"
+       << "  share it. Allocations are counted per thread. Nested phases are not\n"
+       << "  included in their parent.\n"
+       << "  Memory allocated before the report was enabled still counts when it is\n"
+       << "  freed, Kept does not go below 0.\n";
+}
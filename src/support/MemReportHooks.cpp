@@ -0,0 +1,93 @@
+#include "support/MemReport.h"
+#include <malloc.h>
+#include <cstdlib>
+#include <new>
+
+// global allocation hooks of pilla-compiler, everything (including LLVM)
+// allocates through these. they are linked into the executable only, so the
+// benchmarks and other users of pilla-core keep the default allocator.
+// without --mem-report the only extra work is the enabled check
+
+namespace {
+    void* countedAlloc(std::size_t size) {
+        void* p = std::malloc(size ? size : 1);
+        if (p && memReportEnabled()) {
+            countAllocation(malloc_usable_size(p));
+        }
+        return p;
+    }
+
+    // aligned_alloc wants a size that is a multiple of the alignment
+    void* countedAlignedAlloc(std::size_t size, std::align_val_t alignment) {
+        std::size_t align = static_cast<std::size_t>(alignment);
+        std::size_t rounded = size ? (size + align - 1) & ~(align - 1) : align;
+        void* p = std::aligned_alloc(align, rounded);
+        if (p && memReportEnabled()) {
+            countAllocation(malloc_usable_size(p));
+        }
+        return p;
+    }
+
+    void countedFree(void* p) {
+        if (!p) return;
+        if (memReportEnabled()) {
+            countFree(malloc_usable_size(p));
+        }
+        std::free(p);
+    }
+}
+
+void* operator new(std::size_t size) {
+    void* p = countedAlloc(size);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void* operator new[](std::size_t size) {
+    void* p = countedAlloc(size);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    return countedAlloc(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    return countedAlloc(size);
+}
+
+// LLVM's allocate_buffer (DenseMap buckets, BumpPtrAllocator slabs) uses these
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    void* p = countedAlignedAlloc(size, alignment);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+    void* p = countedAlignedAlloc(size, alignment);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return countedAlignedAlloc(size, alignment);
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return countedAlignedAlloc(size, alignment);
+}
+
+void operator delete(void* p) noexcept { countedFree(p); }
+void operator delete[](void* p) noexcept { countedFree(p); }
+void operator delete(void* p, std::size_t) noexcept { countedFree(p); }
+void operator delete[](void* p, std::size_t) noexcept { countedFree(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { countedFree(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { countedFree(p); }
+void operator delete(void* p, std::align_val_t) noexcept { countedFree(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { countedFree(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { countedFree(p); }
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept { countedFree(p); }
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept { countedFree(p); }
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept { countedFree(p); }
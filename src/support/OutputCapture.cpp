@@ -0,0 +1,65 @@
+#include "support/OutputCapture.h"
+#include "llvm/Support/raw_os_ostream.h"
+#include <iostream>
+#include <streambuf>
+
+namespace {
+    thread_local OutputCapture* currentCapture = nullptr;
+
+    // unbuffered, so the text keeps its order with what is written to std::cerr
+    class DiagnosticStream : public llvm::raw_os_ostream {
+        public:
+        DiagnosticStream() : llvm::raw_os_ostream(std::cerr) { SetUnbuffered(); }
+    };
+}
+
+// no put area, every write goes through xsputn/overflow and is routed there
+class CapturingBuffer : public std::streambuf {
+    public:
+    CapturingBuffer(std::streambuf* terminal, bool isErr) : terminal(terminal), isErr(isErr) {}
+
+    protected:
+    std::streamsize xsputn(const char* s, std::streamsize n) override {
+        if (OutputCapture* capture = currentCapture) {
+            (isErr ? capture->errText : capture->outText).append(s, n);
+            return n;
+        }
+        return terminal->sputn(s, n);
+    }
+
+    int_type overflow(int_type c) override {
+        if (traits_type::eq_int_type(c, traits_type::eof())) return traits_type::not_eof(c);
+        char ch = traits_type::to_char_type(c);
+        return xsputn(&ch, 1) == 1 ? c : traits_type::eof();
+    }
+
+    int sync() override {
+        return currentCapture ? 0 : terminal->pubsync();
+    }
+
+    private:
+    std::streambuf* terminal;
+    bool isErr;
+};
+
+void installOutputCapture() {
+    static bool installed = false;
+    if (installed) return;
+    installed = true;
+    // never destroyed, the streams may be used until exit
+    std::cout.rdbuf(new CapturingBuffer(std::cout.rdbuf(), false));
+    std::cerr.rdbuf(new CapturingBuffer(std::cerr.rdbuf(), true));
+}
+
+llvm::raw_ostream& diagnostics() {
+    thread_local DiagnosticStream stream;
+    return stream;
+}
+
+OutputCapture::OutputCapture() : previous(currentCapture) {
+    currentCapture = this;
+}
+
+OutputCapture::~OutputCapture() {
+    currentCapture = previous;
+}
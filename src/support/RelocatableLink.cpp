@@ -0,0 +1,40 @@
+#include "support/RelocatableLink.h"
+#include "support/OutputCapture.h"
+#include "llvm/Support/Program.h"
+#include "llvm/Support/raw_ostream.h"
+#include <optional>
+#include <vector>
+
+bool linkRelocatable(llvm::ArrayRef<std::string> objects, const std::string& output) {
+    auto ld = llvm::sys::findProgramByName("ld");
+    if (!ld) {
+        diagnostics() << "Could not find ld to combine the objects: " << ld.getError().message() << "\n";
+        return false;
+    }
+    std::vector<llvm::StringRef> args = {"ld", "-r", "-o", output};
+    for (const auto& object : objects) {
+        args.push_back(object);
+    }
+    std::string error;
+    int result = llvm::sys::ExecuteAndWait(*ld, args, std::nullopt, {}, 0, 0, &error);
+    if (result != 0) {
+        diagnostics() << "ld -r failed" << (error.empty() ? "" : ": " + error) << "\n";
+        return false;
+    }
+
+    // ld -r keeps hidden symbols global. the pieces only hid them from each
+    // other, the combined object is the whole module, so they become local
+    // like the internal functions of a normal compile
+    auto objcopy = llvm::sys::findProgramByName("objcopy");
+    if (!objcopy) {
+        diagnostics() << "Could not find objcopy to localize hidden symbols: " << objcopy.getError().message() << "\n";
+        return false;
+    }
+    std::vector<llvm::StringRef> localizeArgs = {"objcopy", "--localize-hidden", output};
+    result = llvm::sys::ExecuteAndWait(*objcopy, localizeArgs, std::nullopt, {}, 0, 0, &error);
+    if (result != 0) {
+        diagnostics() << "objcopy --localize-hidden failed" << (error.empty() ? "" : ": " + error) << "\n";
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,69 @@
+#include "support/Timing.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/raw_ostream.h"
+#include <thread>
+
+namespace {
+    bool reportEnabled = false;
+    // phase timers are shared by name, so only one thread may run them
+    std::thread::id reportThread;
+
+    bool traceEnabled = false;
+    unsigned traceGranularity = 0;
+}
+
+void enableTimeReport() {
+    reportEnabled = true;
+    reportThread = std::this_thread::get_id();
+    // makes the pass managers (new PM and the legacy backend one) time every pass
+    llvm::TimePassesIsEnabled = true;
+}
+
+bool timeReportEnabled() {
+    return reportEnabled;
+}
+
+void enableTimeTrace(unsigned granularity) {
+    traceEnabled = true;
+    traceGranularity = granularity;
+    llvm::timeTraceProfilerInitialize(granularity, "pilla-compiler");
+}
+
+void beginThreadTimeTrace() {
+    if (traceEnabled) {
+        llvm::timeTraceProfilerInitialize(traceGranularity, "pilla-compiler");
+    }
+}
+
+void endThreadTimeTrace() {
+    // hands the events of this thread over to the main profiler
+    if (llvm::timeTraceProfilerEnabled()) {
+        llvm::timeTraceProfilerFinishThread();
+    }
+}
+
+bool writeTimeTrace(const std::string& filename) {
+    if (!llvm::timeTraceProfilerEnabled()) return false;
+
+    llvm::Error err = llvm::timeTraceProfilerWrite(filename, "pilla-compiler.json");
+    llvm::timeTraceProfilerCleanup();
+    if (err) {
+        llvm::errs() << "Error: could not write time trace: " << llvm::toString(std::move(err)) << "\n";
+        return false;
+    }
+    return true;
+}
+
+void printTimeReport() {
+    if (!reportEnabled) return;
+    llvm::TimerGroup::printAll(llvm::errs());
+    // already printed, don't print again when the pass managers go away
+    llvm::TimerGroup::clearAll();
+}
+
+PhaseScope::PhaseScope(llvm::StringRef name, llvm::StringRef detail)
+    : trace(name, detail),
+      timer(name, name, "pilla", "Pilla compiler phases",
+            reportEnabled && std::this_thread::get_id() == reportThread),
+      mem(name) {}
@@ -0,0 +1,46 @@
+#include "vm/Bytecode.h"
+
+const char* opcodeName(Opcode op) {
+    static const char* const names[] = {
+#define PILLA_OPCODE_NAME(name) #name,
+        PILLA_OPCODES(PILLA_OPCODE_NAME)
+#undef PILLA_OPCODE_NAME
+    };
+    return names[(unsigned)op];
+}
+
+void BytecodeProgram::dump(std::ostream& os) const {
+    for (const auto& function : functions) {
+        os << function.name << " (" << function.numParams << " params, "
+           << function.numRegs << " registers)\n";
+        for (size_t pc = 0; pc < function.code.size(); pc++) {
+            const Instruction& ins = function.code[pc];
+            os << "  " << pc << "\t" << opcodeName(ins.op);
+            switch (ins.op) {
+                case Opcode::LoadK:
+                    os << " r" << ins.a << ", k" << ins.wide();
+                    break;
+                case Opcode::Jump:
+                    os << " " << ins.wide();
+                    break;
+                case Opcode::JumpIfZero:
+                case Opcode::JumpIfZeroF:
+                    os << " r" << ins.a << ", " << ins.wide();
+                    break;
+                case Opcode::Call:
+                case Opcode::TailCall:
+                    os << " r" << ins.a << ", r" << ins.b << ", " << functions[ins.c].name;
+                    break;
+                case Opcode::Print:
+                    os << " r" << ins.a << ", r" << ins.b << ", \"" << formats[ins.c] << "\"";
+                    break;
+                case Opcode::ReturnVoid:
+                    break;
+                default:
+                    os << " r" << ins.a << ", r" << ins.b << ", r" << ins.c;
+                    break;
+            }
+            os << "\n";
+        }
+    }
+}
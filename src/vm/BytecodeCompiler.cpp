@@ -0,0 +1,426 @@
+#include "vm/BytecodeCompiler.h"
+#include "support/Timing.h"
+#include <iostream>
+
+namespace {
+    // float and double are the same at runtime
+    Type valueType(const std::string& typeName) {
+        if (typeName == "int") return Type::Int;
+        if (typeName == "float" || typeName == "double") return Type::Float;
+        if (typeName == "char") return Type::Char;
+        if (typeName == "string") return Type::String;
+        if (typeName == "void") return Type::Void;
+        return Type::Invalid;
+    }
+
+    bool isNumeric(Type type) {
+        return type == Type::Int || type == Type::Char || type == Type::Float;
+    }
+}
+
+std::unique_ptr<BytecodeProgram> BytecodeCompiler::compile(ProgramAST& ast) {
+    PhaseScope phase("BytecodeCompile");
+    program = std::make_unique<BytecodeProgram>();
+    functionIndex.clear();
+    hasError = false;
+
+    ast.accept(*this);
+
+    if (program->mainFunction < 0) {
+        error("no main function");
+    }
+    if (hasError) return nullptr;
+    return std::move(program);
+}
+
+void BytecodeCompiler::error(const std::string& message) {
+    std::cerr << "Bytecode Error: " << message << std::endl;
+    hasError = true;
+}
+
+uint16_t BytecodeCompiler::allocReg() {
+    if (nextReg > 0xffff) {
+        error("too many registers in function " + function->name);
+        return 0;
+    }
+    unsigned reg = nextReg++;
+    if (nextReg > function->numRegs) function->numRegs = nextReg;
+    return reg;
+}
+
+void BytecodeCompiler::emit(Opcode op, uint16_t a, uint16_t b, uint16_t c) {
+    Instruction ins;
+    ins.op = op;
+    ins.a = a;
+    ins.b = b;
+    ins.c = c;
+    function->code.push_back(ins);
+}
+
+size_t BytecodeCompiler::emitJump(Opcode op, uint16_t a) {
+    emit(op, a);
+    return function->code.size() - 1;
+}
+
+// jump to the next instruction emitted
+void BytecodeCompiler::patchJump(size_t at) {
+    function->code[at].setWide(function->code.size());
+}
+
+void BytecodeCompiler::loadConstant(VMValue value, Type type) {
+    Instruction ins;
+    ins.op = Opcode::LoadK;
+    ins.a = lastReg = allocReg();
+    ins.setWide(program->constants.size());
+    program->constants.push_back(value);
+    function->code.push_back(ins);
+    lastType = type;
+}
+
+void BytecodeCompiler::moveTo(uint16_t dest, Type destType, uint16_t reg, Type type) {
+    if (destType == Type::Float && (type == Type::Int || type == Type::Char)) {
+        emit(Opcode::IntToFloat, dest, reg);
+    } else if (dest != reg) {
+        emit(Opcode::Mov, dest, reg);
+    }
+}
+
+size_t BytecodeCompiler::condition(ExprAST& expr) {
+    expr.accept(*this);
+    if (!isNumeric(lastType)) {
+        error("condition must be an integer or float");
+    }
+    return emitJump(lastType == Type::Float ? Opcode::JumpIfZeroF : Opcode::JumpIfZero, lastReg);
+}
+
+void BytecodeCompiler::statements(std::vector<std::unique_ptr<StmtAST>>& body) {
+    for (auto& stmt : body) {
+        // temporaries never live across statements
+        nextReg = firstTemp;
+        stmt->accept(*this);
+    }
+}
+
+long BytecodeCompiler::visit(ProgramAST& node) {
+    // indices first, so calls can refer to functions defined further down
+    for (auto& func : node.functions) {
+        functionIndex[func->name] = program->functions.size();
+        BytecodeFunction function;
+        function.name = func->name;
+        function.numParams = func->parameters.size();
+        for (const auto& param : func->parameters) {
+            function.paramTypes.push_back(valueType(param.first));
+        }
+        function.returnType = valueType(func->returnType);
+        program->functions.push_back(std::move(function));
+        if (func->name == "main") {
+            program->mainFunction = program->functions.size() - 1;
+        }
+    }
+
+    for (auto& func : node.functions) {
+        func->accept(*this);
+    }
+    return 0;
+}
+
+long BytecodeCompiler::visit(FunctionAST& node) {
+    function = &program->functions[functionIndex[node.name]];
+    variables.clear();
+
+    // parameters arrive in the first registers
+    nextReg = 0;
+    for (const auto& param : node.parameters) {
+        variables[param.second] = {allocReg(), valueType(param.first)};
+    }
+    firstTemp = nextReg;
+
+    statements(node.body);
+
+    // falling off the end returns void, or 0 for a value function
+    if (function->returnType == Type::Void) {
+        emit(Opcode::ReturnVoid);
+    } else {
+        nextReg = firstTemp;
+        VMValue zero;
+        zero.i = 0;
+        loadConstant(zero, Type::Int);
+        moveTo(lastReg, function->returnType, lastReg, Type::Int);
+        emit(Opcode::Return, lastReg);
+    }
+    return 0;
+}
+
+long BytecodeCompiler::visit(VariableDeclAST& node) {
+    // a variable keeps its register for the rest of the function
+    Type type = valueType(node.type);
+    uint16_t reg = allocReg();
+    firstTemp = nextReg;
+
+    if (node.initializer) {
+        node.initializer->accept(*this);
+        moveTo(reg, type, lastReg, lastType);
+    }
+    variables[node.name] = {reg, type};
+    return 0;
+}
+
+long BytecodeCompiler::visit(ReturnStmtAST& node) {
+    if (!node.expression) {
+        emit(Opcode::ReturnVoid);
+        return 0;
+    }
+
+    node.expression->accept(*this);
+    if (lastType == Type::Void) {
+        // return of a void call
+        emit(Opcode::ReturnVoid);
+        return 0;
+    }
+    if (function->returnType == Type::Float && lastType != Type::Float) {
+        uint16_t reg = allocReg();
+        moveTo(reg, Type::Float, lastReg, lastType);
+        lastReg = reg;
+    }
+    emit(Opcode::Return, lastReg);
+    return 0;
+}
+
+long BytecodeCompiler::visit(PrintStmtAST& node) {
+    node.expression->accept(*this);
+    return 0;
+}
+
+long BytecodeCompiler::visit(IfStmtAST& node) {
+    size_t toElse = condition(*node.condition);
+    statements(node.thenBranch);
+
+    if (node.elseBranch.empty()) {
+        patchJump(toElse);
+        return 0;
+    }
+
+    size_t toEnd = emitJump(Opcode::Jump);
+    patchJump(toElse);
+    statements(node.elseBranch);
+    patchJump(toEnd);
+    return 0;
+}
+
+long BytecodeCompiler::visit(WhileStmtAST& node) {
+    size_t top = function->code.size();
+    size_t toEnd = condition(*node.condition);
+
+    statements(node.body);
+
+    size_t back = emitJump(Opcode::Jump);
+    function->code[back].setWide(top);
+    patchJump(toEnd);
+    return 0;
+}
+
+long BytecodeCompiler::visit(ForStmtAST& node) {
+    if (node.initializer) {
+        node.initializer->accept(*this);
+    }
+
+    size_t top = function->code.size();
+    bool hasCondition = node.condition != nullptr;
+    size_t toEnd = 0;
+    if (hasCondition) {
+        nextReg = firstTemp;
+        toEnd = condition(*node.condition);
+    }
+
+    statements(node.body);
+
+    if (node.increment) {
+        nextReg = firstTemp;
+        node.increment->accept(*this);
+    }
+
+    size_t back = emitJump(Opcode::Jump);
+    function->code[back].setWide(top);
+    if (hasCondition) {
+        patchJump(toEnd);
+    }
+    return 0;
+}
+
+long BytecodeCompiler::visit(NumberExprAST& node) {
+    VMValue value;
+    value.i = node.value;
+    loadConstant(value, Type::Int);
+    return 0;
+}
+
+long BytecodeCompiler::visit(FloatExprAST& node) {
+    VMValue value;
+    value.f = node.value;
+    loadConstant(value, Type::Float);
+    return 0;
+}
+
+long BytecodeCompiler::visit(StringExprAST& node) {
+    program->strings.push_back(node.value);
+    VMValue value;
+    value.s = program->strings.back().c_str();
+    loadConstant(value, Type::String);
+    return 0;
+}
+
+long BytecodeCompiler::visit(CharExprAST& node) {
+    VMValue value;
+    value.i = node.value;
+    loadConstant(value, Type::Char);
+    return 0;
+}
+
+long BytecodeCompiler::visit(VariableExprAST& node) {
+    auto it = variables.find(node.name);
+    if (it == variables.end()) {
+        error("unknown variable " + node.name);
+        lastType = Type::Invalid;
+        return 0;
+    }
+    // no copy, the variable's register is the value
+    lastReg = it->second.first;
+    lastType = it->second.second;
+    return 0;
+}
+
+long BytecodeCompiler::visit(CallExprAST& node) {
+    // arguments go into consecutive registers
+    unsigned base = nextReg;
+    std::string kinds;
+    const BytecodeFunction* callee = nullptr;
+    unsigned index = 0;
+
+    if (node.callee != "printf") {
+        auto it = functionIndex.find(node.callee);
+        if (it == functionIndex.end()) {
+            error("unknown function " + node.callee);
+            lastType = Type::Invalid;
+            return 0;
+        }
+        index = it->second;
+        callee = &program->functions[index];
+        if (callee->numParams != node.args.size()) {
+            error("incorrect number of arguments passed to " + node.callee);
+        }
+    }
+
+    for (size_t i = 0; i < node.args.size(); i++) {
+        nextReg = base + i;
+        uint16_t slot = allocReg();
+        node.args[i]->accept(*this);
+
+        // convert to the parameter type like a store would
+        Type type = callee && i < callee->paramTypes.size() ? callee->paramTypes[i] : lastType;
+        moveTo(slot, type, lastReg, lastType);
+
+        switch (type) {
+            case Type::Int: kinds += 'i'; break;
+            case Type::Float: kinds += 'f'; break;
+            case Type::Char: kinds += 'c'; break;
+            case Type::String: kinds += 's'; break;
+            default:
+                error("cannot pass a value of this type to " + node.callee);
+                break;
+        }
+    }
+    nextReg = base + node.args.size();
+
+    if (!callee) {
+        // printf: the format is fixed by the argument types, like in Codegen
+        uint16_t dest = allocReg();
+        emit(Opcode::Print, dest, base, program->formats.size());
+        program->formats.push_back(kinds);
+        lastReg = dest;
+        lastType = Type::Int;
+        return 0;
+    }
+
+    // reuse the frame for return f(...) when no conversion is needed afterwards
+    if (node.tailCall && callee->returnType == function->returnType) {
+        emit(Opcode::TailCall, 0, base, index);
+        lastType = Type::Void;
+        lastReg = 0;
+        // the return that follows is unreachable
+        return 0;
+    }
+
+    uint16_t dest = allocReg();
+    emit(Opcode::Call, dest, base, index);
+    lastReg = dest;
+    lastType = callee->returnType;
+    return 0;
+}
+
+long BytecodeCompiler::visit(BinaryExprAST& node) {
+    if (node.op == Tokentype::ASSIGN) {
+        VariableExprAST* var = dynamic_cast<VariableExprAST*>(node.left.get());
+        if (!var || !variables.count(var->name)) {
+            error("left side of assignment must be a variable");
+            lastType = Type::Invalid;
+            return 0;
+        }
+        auto target = variables[var->name];
+        node.right->accept(*this);
+        moveTo(target.first, target.second, lastReg, lastType);
+        // the assignment's value is the variable
+        lastReg = target.first;
+        lastType = target.second;
+        return 0;
+    }
+
+    node.left->accept(*this);
+    uint16_t left = lastReg;
+    Type leftType = lastType;
+    node.right->accept(*this);
+    uint16_t right = lastReg;
+    Type rightType = lastType;
+
+    if (!isNumeric(leftType) || !isNumeric(rightType)) {
+        error("invalid operands to binary operator");
+        lastType = Type::Invalid;
+        return 0;
+    }
+
+    bool isFloat = leftType == Type::Float || rightType == Type::Float;
+    if (isFloat && leftType != Type::Float) {
+        uint16_t reg = allocReg();
+        moveTo(reg, Type::Float, left, leftType);
+        left = reg;
+    }
+    if (isFloat && rightType != Type::Float) {
+        uint16_t reg = allocReg();
+        moveTo(reg, Type::Float, right, rightType);
+        right = reg;
+    }
+
+    Opcode op;
+    switch (node.op) {
+        case Tokentype::PLUS: op = isFloat ? Opcode::AddF : Opcode::AddI; break;
+        case Tokentype::MINUS: op = isFloat ? Opcode::SubF : Opcode::SubI; break;
+        case Tokentype::MULTIPLY: op = isFloat ? Opcode::MulF : Opcode::MulI; break;
+        case Tokentype::DIVIDE: op = isFloat ? Opcode::DivF : Opcode::DivI; break;
+        case Tokentype::MODULO: op = isFloat ? Opcode::ModF : Opcode::ModI; break;
+        case Tokentype::LESS_THAN: op = isFloat ? Opcode::LtF : Opcode::LtI; break;
+        case Tokentype::GRE_THAN: op = isFloat ? Opcode::GtF : Opcode::GtI; break;
+        case Tokentype::LESS_EQUAL: op = isFloat ? Opcode::LeF : Opcode::LeI; break;
+        case Tokentype::GREATER_EQUAL: op = isFloat ? Opcode::GeF : Opcode::GeI; break;
+        case Tokentype::EQUAL_EQUAL: op = isFloat ? Opcode::EqF : Opcode::EqI; break;
+        case Tokentype::NOT_EQUAL: op = isFloat ? Opcode::NeF : Opcode::NeI; break;
+        default:
+            error("invalid binary operator");
+            lastType = Type::Invalid;
+            return 0;
+    }
+
+    uint16_t dest = allocReg();
+    emit(op, dest, left, right);
+    lastReg = dest;
+    lastType = isFloat ? Type::Float : Type::Int;
+    return 0;
+}
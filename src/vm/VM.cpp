@@ -0,0 +1,218 @@
+#include "vm/VM.h"
+#include "support/Timing.h"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+// labels as values are a gcc/clang extension
+#if defined(__GNUC__)
+#define PILLA_COMPUTED_GOTO 1
+#endif
+
+namespace {
+    struct Frame {
+        const BytecodeFunction* function;
+        const Instruction* returnPc;
+        VMValue* regs;
+        uint16_t dest;
+    };
+}
+
+void VM::runtimeError(const BytecodeFunction& function, const char* message) {
+    std::fflush(stdout);
+    std::cerr << "Runtime Error: " << message << " in " << function.name << std::endl;
+}
+
+bool VM::run(const BytecodeProgram& program, int& exitCode) {
+    PhaseScope phase("Interpret");
+    exitCode = 0;
+    if (program.mainFunction < 0) return false;
+
+    // left uninitialized, only the pages that are used get touched
+    std::unique_ptr<VMValue[]> stack(new VMValue[stackSize]);
+    const VMValue* stackEnd = stack.get() + stackSize;
+    std::vector<Frame> frames;
+    frames.reserve(256);
+
+    const BytecodeFunction* function = &program.functions[program.mainFunction];
+    const BytecodeFunction* functions = program.functions.data();
+    const VMValue* constants = program.constants.data();
+    VMValue* regs = stack.get();
+    const Instruction* pc = function->code.data();
+    const Instruction* ins = nullptr;
+    VMValue result;
+    result.i = 0;
+
+#ifdef PILLA_COMPUTED_GOTO
+    // -Wpedantic flags the label table and every goto *, only for the dispatch loop
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+    static void* const labels[] = {
+#define PILLA_OPCODE_LABEL(name) &&op_##name,
+        PILLA_OPCODES(PILLA_OPCODE_LABEL)
+#undef PILLA_OPCODE_LABEL
+    };
+#define CASE(name) op_##name:
+#define DISPATCH() do { ins = pc++; goto *labels[(unsigned)ins->op]; } while (0)
+    DISPATCH();
+#else
+#define CASE(name) case Opcode::name:
+#define DISPATCH() continue
+    for (;;) {
+        ins = pc++;
+        switch (ins->op) {
+#endif
+
+#define BINARY(name, field, expr) \
+    CASE(name) { \
+        const VMValue l = regs[ins->b]; \
+        const VMValue r = regs[ins->c]; \
+        regs[ins->a].field = (expr); \
+        DISPATCH(); \
+    }
+
+    CASE(Mov)
+        regs[ins->a] = regs[ins->b];
+        DISPATCH();
+    CASE(LoadK)
+        regs[ins->a] = constants[ins->wide()];
+        DISPATCH();
+    CASE(IntToFloat)
+        regs[ins->a].f = (double)regs[ins->b].i;
+        DISPATCH();
+
+    // two's complement wrap around like the add/sub/mul Codegen emits (no nsw),
+    // signed overflow would be undefined in C++
+    BINARY(AddI, i, (int64_t)((uint64_t)l.i + (uint64_t)r.i))
+    BINARY(SubI, i, (int64_t)((uint64_t)l.i - (uint64_t)r.i))
+    BINARY(MulI, i, (int64_t)((uint64_t)l.i * (uint64_t)r.i))
+    CASE(DivI)
+        if (regs[ins->c].i == 0) {
+            runtimeError(*function, "division by zero");
+            return false;
+        }
+        regs[ins->a].i = regs[ins->b].i / regs[ins->c].i;
+        DISPATCH();
+    CASE(ModI)
+        if (regs[ins->c].i == 0) {
+            runtimeError(*function, "division by zero");
+            return false;
+        }
+        regs[ins->a].i = regs[ins->b].i % regs[ins->c].i;
+        DISPATCH();
+    BINARY(LtI, i, l.i < r.i)
+    BINARY(GtI, i, l.i > r.i)
+    BINARY(LeI, i, l.i <= r.i)
+    BINARY(GeI, i, l.i >= r.i)
+    BINARY(EqI, i, l.i == r.i)
+    BINARY(NeI, i, l.i != r.i)
+
+    BINARY(AddF, f, l.f + r.f)
+    BINARY(SubF, f, l.f - r.f)
+    BINARY(MulF, f, l.f * r.f)
+    BINARY(DivF, f, l.f / r.f)
+    BINARY(ModF, f, std::fmod(l.f, r.f))
+    // unordered compares, same as the fcmp u* Codegen emits
+    BINARY(LtF, f, !(l.f >= r.f))
+    BINARY(GtF, f, !(l.f <= r.f))
+    BINARY(LeF, f, !(l.f > r.f))
+    BINARY(GeF, f, !(l.f < r.f))
+    BINARY(EqF, f, !(l.f < r.f || l.f > r.f))
+    BINARY(NeF, f, l.f != r.f)
+
+    CASE(Jump)
+        pc = function->code.data() + ins->wide();
+        DISPATCH();
+    CASE(JumpIfZero)
+        if (regs[ins->a].i == 0) pc = function->code.data() + ins->wide();
+        DISPATCH();
+    CASE(JumpIfZeroF)
+        if (regs[ins->a].f == 0.0) pc = function->code.data() + ins->wide();
+        DISPATCH();
+
+    CASE(Call) {
+        const BytecodeFunction* callee = &functions[ins->c];
+        VMValue* calleeRegs = regs + function->numRegs;
+        if (calleeRegs + callee->numRegs > stackEnd) {
+            runtimeError(*callee, "stack overflow");
+            return false;
+        }
+        std::memcpy(calleeRegs, regs + ins->b, callee->numParams * sizeof(VMValue));
+        frames.push_back({function, pc, regs, ins->a});
+        function = callee;
+        regs = calleeRegs;
+        pc = callee->code.data();
+        DISPATCH();
+    }
+    CASE(TailCall) {
+        // the arguments replace the parameters, the frame stays
+        const BytecodeFunction* callee = &functions[ins->c];
+        if (regs + callee->numRegs > stackEnd) {
+            runtimeError(*callee, "stack overflow");
+            return false;
+        }
+        std::memmove(regs, regs + ins->b, callee->numParams * sizeof(VMValue));
+        function = callee;
+        pc = callee->code.data();
+        DISPATCH();
+    }
+    CASE(Return)
+        result = regs[ins->a];
+        if (frames.empty()) {
+            exitCode = function->returnType == Type::Float ? (int)result.f : (int)result.i;
+            return true;
+        } else {
+            const Frame& frame = frames.back();
+            function = frame.function;
+            pc = frame.returnPc;
+            regs = frame.regs;
+            regs[frame.dest] = result;
+            frames.pop_back();
+        }
+        DISPATCH();
+    CASE(ReturnVoid)
+        if (frames.empty()) {
+            return true;
+        } else {
+            const Frame& frame = frames.back();
+            function = frame.function;
+            pc = frame.returnPc;
+            regs = frame.regs;
+            frames.pop_back();
+        }
+        DISPATCH();
+
+    CASE(Print) {
+        // one printf per argument; the text matches Codegen's single printf:
+        // values separated by spaces, then a newline
+        const std::string& kinds = program.formats[ins->c];
+        const VMValue* args = regs + ins->b;
+        int written = 0;
+        for (size_t k = 0; k < kinds.size(); k++) {
+            if (k) written += std::printf(" ");
+            switch (kinds[k]) {
+                case 'i': written += std::printf("%ld", (long)args[k].i); break;
+                case 'f': written += std::printf("%f", args[k].f); break;
+                case 'c': written += std::printf("%c", (char)args[k].i); break;
+                case 's': written += std::printf("%s", args[k].s); break;
+            }
+        }
+        written += std::printf("\n");
+        regs[ins->a].i = written;
+        DISPATCH();
+    }
+
+#ifndef PILLA_COMPUTED_GOTO
+        }
+    }
+#else
+#pragma GCC diagnostic pop
+#endif
+
+#undef BINARY
+#undef CASE
+#undef DISPATCH
+}